@@ -0,0 +1,81 @@
+//
+//  bench/batch.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "sgss/aperture.h"
+#include "sgss/lens_blur_filter.h"
+
+// Measures time per image of filtering bursts of images with the same
+// gradient at once, against filtering them one by one.
+int main(int argc, char **argv) {
+  const int repeat = argc > 1 ? std::atoi(argv[1]) : 3;
+  const cv::Size size(1920, 1080);
+  cv::Mat1b gradient(size);
+  for (int y = 0; y < size.height; ++y) {
+    for (int x = 0; x < size.width; ++x) {
+      gradient(y, x) = cv::saturate_cast<uchar>(x * 255.0 / size.width);
+    }
+  }
+  sgss::LensBlurFilter filter(sgss::Aperture::Polygon(6, 0.0),
+                              cv::Size(27, 27));
+  filter.set_gradient(gradient);
+
+  std::printf("%-6s %14s %14s %9s\n",
+              "images", "separate ms", "batched ms", "speedup");
+  for (int count = 1; count <= 8; count *= 2) {
+    std::vector<cv::Mat> sources(count);
+    for (auto& source : sources) {
+      source.create(size, CV_8UC3);
+      cv::randu(source, cv::Scalar::all(0), cv::Scalar::all(256));
+    }
+    std::vector<cv::Mat> destinations(count);
+    filter(sources, &destinations);  // Warm up
+
+    int64 start = cv::getTickCount();
+    for (int i = 0; i < repeat; ++i) {
+      for (int j = 0; j < count; ++j) {
+        filter(sources[j], &destinations[j]);
+      }
+    }
+    const double separate_time = (cv::getTickCount() - start) * 1000.0 /
+                                 cv::getTickFrequency() / repeat / count;
+    start = cv::getTickCount();
+    for (int i = 0; i < repeat; ++i) {
+      filter(sources, &destinations);
+    }
+    const double batched_time = (cv::getTickCount() - start) * 1000.0 /
+                                cv::getTickFrequency() / repeat / count;
+    std::printf("%-6d %14.3f %14.3f %8.2fx\n",
+                count, separate_time, batched_time,
+                separate_time / batched_time);
+  }
+  return EXIT_SUCCESS;
+}
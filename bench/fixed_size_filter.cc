@@ -0,0 +1,83 @@
+//
+//  bench/fixed_size_filter.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "sgss/aperture.h"
+#include "sgss/engine.h"
+#include "sgss/kernel_structure.h"
+
+// Measures the engine that the gradient filter chooses by default against
+// the generic linear filter of OpenCV for every odd size up to 27 x 27, on a
+// disc kernel and a full HD image. Sizes without a fixed-size filter show the
+// engine chosen in its place.
+int main(int argc, char **argv) {
+  const int repeat = argc > 1 ? std::atoi(argv[1]) : 10;
+  const int type = cv::DataType<cv::Vec3f>::type;
+  cv::Mat3f source(1080, 1920);
+  cv::randu(source, cv::Scalar::all(0.0), cv::Scalar::all(1.0));
+  cv::Mat3f generic_result(source.size());
+  cv::Mat3f chosen_result(source.size());
+
+  const auto measure = [&](const cv::Ptr<cv::FilterEngine>& filter,
+                           cv::Mat3f *destination) {
+    filter->apply(source, *destination);  // Warm up
+    const int64 start = cv::getTickCount();
+    for (int i = 0; i < repeat; ++i) {
+      filter->apply(source, *destination);
+    }
+    return (cv::getTickCount() - start) * 1000.0 /
+           cv::getTickFrequency() / repeat;
+  };
+
+  std::printf("%-8s %-11s %12s %12s %9s %12s\n",
+              "size", "engine", "generic ms", "chosen ms", "speedup",
+              "max error");
+  for (int size = 1; size <= 27; size += 2) {
+    cv::Mat1f kernel;
+    cv::normalize(sgss::Aperture::Disc().Rasterize(cv::Size(size, size)),
+                  kernel, 1.0, 0.0, cv::NORM_L1);
+    const sgss::KernelStructure structure(kernel);
+    const sgss::KernelStructure run_structure(
+        sgss::RunStructure(kernel, structure, 0.0));
+    sgss::Engine engine;
+    const cv::Ptr<cv::FilterEngine> chosen_filter(sgss::CreateDefaultEngine(
+        kernel, structure, run_structure, type, &engine));
+    const cv::Ptr<cv::FilterEngine> generic_filter(
+        cv::createLinearFilter(type, type, kernel));
+    const double generic_time = measure(generic_filter, &generic_result);
+    const double chosen_time = measure(chosen_filter, &chosen_result);
+    const double error = cv::norm(generic_result, chosen_result,
+                                  cv::NORM_INF);
+    std::printf("%2d x %-3d %-11s %12.3f %12.3f %8.2fx %12g\n",
+                size, size, sgss::EngineName(engine), generic_time,
+                chosen_time, generic_time / chosen_time, error);
+  }
+  return EXIT_SUCCESS;
+}
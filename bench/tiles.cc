@@ -0,0 +1,74 @@
+//
+//  bench/tiles.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "sgss/aperture.h"
+#include "sgss/lens_blur_filter.h"
+
+// Measures filtering a large image tile by tile at several tile sizes,
+// against filtering it at once with intermediate images of the whole size.
+int main(int argc, char **argv) {
+  const int repeat = argc > 1 ? std::atoi(argv[1]) : 3;
+  const cv::Size size(3840, 2160);
+  cv::Mat3b source(size);
+  cv::randu(source, cv::Scalar::all(0), cv::Scalar::all(256));
+  cv::Mat1b gradient(size);
+  for (int y = 0; y < size.height; ++y) {
+    for (int x = 0; x < size.width; ++x) {
+      gradient(y, x) = cv::saturate_cast<uchar>(x * 255.0 / size.width);
+    }
+  }
+  sgss::LensBlurFilter filter(sgss::Aperture::Polygon(6, 0.0),
+                              cv::Size(27, 27));
+  filter.set_gradient(gradient);
+
+  cv::Mat whole;
+  cv::Mat tiled;
+  const auto measure = [&](cv::Mat *destination) {
+    filter(source, destination);  // Warm up
+    const int64 start = cv::getTickCount();
+    for (int i = 0; i < repeat; ++i) {
+      filter(source, destination);
+    }
+    return (cv::getTickCount() - start) * 1000.0 /
+           cv::getTickFrequency() / repeat;
+  };
+  const double whole_time = measure(&whole);
+  std::printf("%-10s %10s %9s %10s\n", "tile", "ms", "speedup", "max error");
+  std::printf("%-10s %10.3f %8.2fx %10d\n", "whole", whole_time, 1.0, 0);
+  for (int edge = 64; edge <= 512; edge *= 2) {
+    filter.set_tile_size(cv::Size(edge, edge));
+    const double time = measure(&tiled);
+    const double error = cv::norm(whole, tiled, cv::NORM_INF);
+    std::printf("%4d x %-4d %10.3f %8.2fx %10g\n",
+                edge, edge, time, whole_time / time, error);
+  }
+  return EXIT_SUCCESS;
+}
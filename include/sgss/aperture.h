@@ -0,0 +1,107 @@
+//
+//  sgss/aperture.h
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+#ifndef SGSS_APERTURE_H_
+#define SGSS_APERTURE_H_
+
+#ifdef __cplusplus
+
+#include <opencv2/opencv.hpp>
+
+#include <cassert>
+#include <vector>
+
+namespace sgss {
+
+class Aperture {
+ public:
+  enum class Shape {
+    kDisc,     // Circular aperture
+    kPolygon,  // Regular polygon formed by diaphragm blades
+    kRing,     // Annulus of catadioptric (mirror) lenses
+  };
+
+  // Constructors
+  static Aperture Disc();
+  static Aperture Polygon(int blades, double rotation = 0.0);
+  static Aperture Ring(double inner_ratio);
+
+  // Rasterizes the aperture inscribed in the given size, where every pixel
+  // holds the exact fraction of its area covered by the aperture
+  cv::Mat1f Rasterize(const cv::Size& size) const;
+
+  // Attributes
+  Shape shape() const { return shape_; }
+  int blades() const { return blades_; }
+  double rotation() const { return rotation_; }
+  double inner_ratio() const { return inner_ratio_; }
+
+ private:
+  // Constructors
+  Aperture(Shape shape, int blades, double rotation, double inner_ratio);
+
+  // Vertices of the convex outline inscribed in the given size, around the
+  // origin in order
+  std::vector<cv::Point2d> Outline(const cv::Size2d& size) const;
+
+  // Data members
+  Shape shape_;
+  int blades_;
+  double rotation_;
+  double inner_ratio_;
+};
+
+#pragma mark - Inline Implementations
+
+inline Aperture::Aperture(Shape shape,
+                          int blades,
+                          double rotation,
+                          double inner_ratio)
+    : shape_(shape),
+      blades_(blades),
+      rotation_(rotation),
+      inner_ratio_(inner_ratio) {}
+
+inline Aperture Aperture::Disc() {
+  return Aperture(Shape::kDisc, 0, 0.0, 0.0);
+}
+
+inline Aperture Aperture::Polygon(int blades, double rotation) {
+  assert(blades >= 3);
+  return Aperture(Shape::kPolygon, blades, rotation, 0.0);
+}
+
+inline Aperture Aperture::Ring(double inner_ratio) {
+  assert(inner_ratio >= 0.0 && inner_ratio < 1.0);
+  return Aperture(Shape::kRing, 0, 0.0, inner_ratio);
+}
+
+}  // namespace sgss
+
+#endif  // __cplusplus
+
+#endif  // SGSS_APERTURE_H_
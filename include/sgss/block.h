@@ -0,0 +1,82 @@
+//
+//  sgss/block.h
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+#ifndef SGSS_BLOCK_H_
+#define SGSS_BLOCK_H_
+
+#ifdef __cplusplus
+
+#include <opencv2/opencv.hpp>
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace sgss {
+
+// Rectangular region to be filtered with the same range of filter indices
+struct Block {
+  using Index = std::make_signed<std::size_t>::type;
+
+  // Constructors
+  Block();
+  Block(const cv::Rect& rect, Index lower_index, Index upper_index);
+
+  // Whether the given block needs exactly the same filters
+  bool SpansEqual(const Block& other) const;
+
+  // Data members
+  cv::Rect rect;
+  Index lower_index;
+  Index upper_index;
+};
+
+// Merges neighbouring blocks that share an identical range of filter indices
+// into larger rectangles, until no more pairs can be merged. Blocks must not
+// overlap each other. Returns the number of blocks removed.
+std::size_t CoalesceBlocks(std::vector<Block> *blocks);
+
+#pragma mark - Inline Implementations
+
+inline Block::Block()
+    : lower_index(),
+      upper_index() {}
+
+inline Block::Block(const cv::Rect& rect, Index lower_index, Index upper_index)
+    : rect(rect),
+      lower_index(lower_index),
+      upper_index(upper_index) {}
+
+inline bool Block::SpansEqual(const Block& other) const {
+  return lower_index == other.lower_index && upper_index == other.upper_index;
+}
+
+}  // namespace sgss
+
+#endif  // __cplusplus
+
+#endif  // SGSS_BLOCK_H_
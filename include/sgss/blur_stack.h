@@ -0,0 +1,106 @@
+//
+//  sgss/blur_stack.h
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+#ifndef SGSS_BLUR_STACK_H_
+#define SGSS_BLUR_STACK_H_
+
+#ifdef __cplusplus
+
+#include <opencv2/opencv.hpp>
+
+#include <cstddef>
+#include <list>
+#include <type_traits>
+
+namespace sgss {
+
+class BlurStack {
+ public:
+  using Index = std::make_signed<std::size_t>::type;
+
+  enum class Precision {
+    kFull,  // Retains levels in single precision
+    kHalf,  // Retains levels in half precision, taking half the memory
+  };
+
+  // Constructors
+  explicit BlurStack(std::size_t memory_limit = 0,
+                     Precision precision = Precision::kFull);
+
+  // Binds the source of blurred levels, and returns it in single precision.
+  // Levels retained for the previous source are discarded unless the given
+  // one refers to the same data as it, or as the matrix returned for it.
+  const cv::Mat3f& Bind(const cv::Mat& source);
+
+  // Discards the source and all the levels retained
+  void Clear();
+
+  // Copies the given rectangle of the blurred level at the index to the
+  // destination, and returns true when the level is retained
+  bool Fetch(Index index, const cv::Rect& rect, cv::Mat3f *destination);
+
+  // Retains the blurred level at the index, dropping least recently used
+  // levels when the memory limit is exceeded
+  void Store(Index index, const cv::Mat3f& level);
+
+  // Attributes
+  std::size_t memory_limit() const { return memory_limit_; }
+  Precision precision() const { return precision_; }
+  std::size_t memory_usage() const { return memory_usage_; }
+  std::size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+
+ private:
+  struct Entry {
+    Index index;
+    cv::Mat level;
+  };
+
+  // Data members
+  std::size_t memory_limit_;
+  Precision precision_;
+  std::size_t memory_usage_;
+  cv::Mat key_;
+  cv::Mat3f source_;
+  std::list<Entry> entries_;  // Ordered from the most recently used
+};
+
+// Whether the two matrices refer to the same data in the same layout
+bool SharesData(const cv::Mat& a, const cv::Mat& b);
+
+#pragma mark - Inline Implementations
+
+inline BlurStack::BlurStack(std::size_t memory_limit, Precision precision)
+    : memory_limit_(memory_limit),
+      precision_(precision),
+      memory_usage_() {}
+
+}  // namespace sgss
+
+#endif  // __cplusplus
+
+#endif  // SGSS_BLUR_STACK_H_
@@ -0,0 +1,146 @@
+//
+//  sgss/engine.h
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+#ifndef SGSS_ENGINE_H_
+#define SGSS_ENGINE_H_
+
+#ifdef __cplusplus
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "sgss/kernel_structure.h"
+
+namespace sgss {
+
+// Kinds of filter engines that convolve a level of the gradient filter
+enum class Engine {
+  kGeneric,    // Linear filter of OpenCV
+  kSeparable,  // Separable linear filter of OpenCV
+  kRunLength,  // Run-length filter
+  kFixedSize,  // Filter specialized for the kernel size
+};
+
+// Name of the engine used in profiles
+const char *EngineName(Engine engine);
+
+// Finds the engine of the given name, and returns false if none matches
+bool EngineFromName(const std::string& name, Engine *engine);
+
+// Creates a filter engine of the two-dimensional filter for the given type of
+// images, with the same border as linear filters of OpenCV by default
+cv::Ptr<cv::FilterEngine> CreateFilterEngine(
+    const cv::Ptr<cv::BaseFilter>& filter,
+    int type);
+
+// Encodes the kernel into runs of weights equal within the relative
+// tolerance. With zero tolerance, a kernel close to binary, such as an
+// aperture taken from a photograph, is encoded within 10% when that makes its
+// runs long and approximates its weights within 5% of their sum. Otherwise
+// only weights equal within rounding errors are merged.
+KernelStructure RunStructure(const cv::Mat1f& kernel,
+                             const KernelStructure& structure,
+                             double tolerance);
+
+// Whether the runs of the structure are long enough on average for the
+// run-length engine to be faster than multiplying every tap
+bool HasLongRuns(const KernelStructure& run_structure);
+
+// Creates a filter engine of the given kind for the kernel and type of single
+// precision images, or an empty pointer when the kind doesn't apply to the
+// kernel. Run-length filters encode runs in the given run structure.
+cv::Ptr<cv::FilterEngine> CreateEngine(Engine engine,
+                                       const cv::Mat1f& kernel,
+                                       const KernelStructure& structure,
+                                       const KernelStructure& run_structure,
+                                       int type);
+
+// Creates the filter engine expected to be the fastest of those that apply to
+// the kernel without measuring, and stores its kind in the engine
+cv::Ptr<cv::FilterEngine> CreateDefaultEngine(
+    const cv::Mat1f& kernel,
+    const KernelStructure& structure,
+    const KernelStructure& run_structure,
+    int type,
+    Engine *engine);
+
+// Filters a random image of the given size with every engine that applies to
+// the kernel, and returns the one that took the shortest time
+Engine MeasureFastestEngine(const cv::Mat1f& kernel,
+                            const KernelStructure& structure,
+                            const KernelStructure& run_structure,
+                            const cv::Size& tile_size,
+                            int repeat);
+
+// Fastest engines measured for kernels on a host, which can be saved and
+// loaded later to skip measuring again. Kernels are identified by a hash of
+// their size and weights together with the tolerance of runs, so that
+// apertures of the same size don't share engines.
+class EngineProfile {
+ public:
+  // Constructors
+  EngineProfile();
+
+  // Name of the host the engines were measured on
+  const std::string& host() const { return host_; }
+
+  // Finds the engine for the given normalized kernel and tolerance of runs,
+  // and returns false if none has been measured
+  bool Find(const cv::Mat1f& kernel, double run_tolerance,
+            Engine *engine) const;
+  void Insert(const cv::Mat1f& kernel, double run_tolerance, Engine engine);
+
+  // Number of kernels measured
+  bool empty() const { return entries_.empty(); }
+  std::size_t size() const { return entries_.size(); }
+
+  // Reads or writes the profile in any format of cv::FileStorage. Loading
+  // fails for profiles made on another host.
+  bool Load(const std::string& path);
+  bool Save(const std::string& path) const;
+
+ private:
+  // Engine measured for a kernel, with its size kept for readers of the
+  // saved profile
+  struct Entry {
+    cv::Size size;
+    Engine engine;
+  };
+
+  // Data members
+  std::string host_;
+  std::map<std::uint64_t, Entry> entries_;
+};
+
+}  // namespace sgss
+
+#endif  // __cplusplus
+
+#endif  // SGSS_ENGINE_H_
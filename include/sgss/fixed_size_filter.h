@@ -0,0 +1,162 @@
+//
+//  sgss/fixed_size_filter.h
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+#ifndef SGSS_FIXED_SIZE_FILTER_H_
+#define SGSS_FIXED_SIZE_FILTER_H_
+
+#ifdef __cplusplus
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cassert>
+
+namespace sgss {
+
+// Calls the function with every index from zero to the count exclusive,
+// unrolled at compile time
+template <int Count>
+struct Unrolled {
+  template <typename Function>
+  static void Apply(const Function& function) {
+    Unrolled<Count - 1>::Apply(function);
+    function(Count - 1);
+  }
+};
+
+template <>
+struct Unrolled<0> {
+  template <typename Function>
+  static void Apply(const Function&) {}
+};
+
+// Two-dimensional filter of single precision images specialized for the size
+// of the kernel and the number of channels. Loops over taps and channels are
+// fully unrolled, and sums of a tile of output pixels are accumulated
+// together, so that every tap weight is loaded once per tile.
+template <int Width, int Height, int Channels>
+class FixedSizeFilter : public cv::BaseFilter {
+ public:
+  static_assert(Width % 2 == 1 && Height % 2 == 1,
+                "Kernel size must be odd");
+
+  // Number of output pixels accumulated together, so that their sums for
+  // every channel fit in registers of common targets
+  static constexpr int kTileWidth = Channels < 12 ? 12 / Channels : 1;
+
+  // Constructors
+  explicit FixedSizeFilter(const cv::Mat1f& kernel);
+
+  // Filters the given number of rows
+  virtual void operator()(const uchar **source,
+                          uchar *destination,
+                          int destination_step,
+                          int count,
+                          int width,
+                          int channels) override;
+
+ private:
+  // Filters the given number of pixels starting at the column
+  template <int Pixels>
+  void Accumulate(const float * const *rows, int x, float *result) const;
+
+  // Data members
+  float weights_[Width * Height];
+};
+
+// Creates a filter engine of the fixed-size filter for the given kernel and
+// type of single precision images, or an empty pointer when no filter is
+// instantiated for the size of the kernel and the number of channels
+cv::Ptr<cv::FilterEngine> CreateFixedSizeFilter(const cv::Mat1f& kernel,
+                                                int type);
+
+#pragma mark - Inline Implementations
+
+template <int Width, int Height, int Channels>
+inline FixedSizeFilter<Width, Height, Channels>::FixedSizeFilter(
+    const cv::Mat1f& kernel) {
+  assert(kernel.cols == Width && kernel.rows == Height);
+  ksize = cv::Size(Width, Height);
+  anchor = cv::Point(Width / 2, Height / 2);
+  for (int y = 0; y < Height; ++y) {
+    std::copy(kernel[y], kernel[y] + Width, weights_ + y * Width);
+  }
+}
+
+template <int Width, int Height, int Channels>
+inline void FixedSizeFilter<Width, Height, Channels>::operator()(
+    const uchar **source,
+    uchar *destination,
+    int destination_step,
+    int count,
+    int width,
+    int channels) {
+  assert(channels == Channels);
+  const float *rows[Height];
+  for (int index = 0; index < count; ++index) {
+    Unrolled<Height>::Apply([&](int y) {
+      rows[y] = reinterpret_cast<const float *>(source[index + y]);
+    });
+    float *result = reinterpret_cast<float *>(
+        destination + destination_step * index);
+    int x = 0;
+    for (; x + kTileWidth <= width; x += kTileWidth) {
+      Accumulate<kTileWidth>(rows, x, result);
+    }
+    for (; x < width; ++x) {
+      Accumulate<1>(rows, x, result);
+    }
+  }
+}
+
+template <int Width, int Height, int Channels>
+template <int Pixels>
+inline void FixedSizeFilter<Width, Height, Channels>::Accumulate(
+    const float * const *rows,
+    int x,
+    float *result) const {
+  // Channels of neighbouring pixels are adjacent, so that the sums of the
+  // tile are a single run of elements shifted by every tap.
+  float sums[Pixels * Channels] = {};
+  Unrolled<Height>::Apply([&](int ky) {
+    const float *row = rows[ky] + x * Channels;
+    Unrolled<Width>::Apply([&](int kx) {
+      const float weight = weights_[ky * Width + kx];
+      const float *taps = row + kx * Channels;
+      Unrolled<Pixels * Channels>::Apply([&](int i) {
+        sums[i] += weight * taps[i];
+      });
+    });
+  });
+  std::copy(sums, sums + Pixels * Channels, result + x * Channels);
+}
+
+}  // namespace sgss
+
+#endif  // __cplusplus
+
+#endif  // SGSS_FIXED_SIZE_FILTER_H_
@@ -34,25 +34,49 @@
 
 #include <cassert>
 #include <cstddef>
+#include <memory>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "sgss/aperture.h"
+#include "sgss/block.h"
+#include "sgss/blur_stack.h"
+#include "sgss/engine.h"
 #include "sgss/filter.h"
+#include "sgss/kernel_structure.h"
+#include "sgss/quadtree.h"
+#include "sgss/workspace.h"
 
 namespace sgss {
 
-class Quadtree;
-
 class GradientFilter : public Filter {
  public:
-  using Index = std::make_signed<std::size_t>::type;
+  using Index = Block::Index;
+
+  // Cost of filtering a set of blocks
+  struct Cost {
+    std::size_t blocks;
+    std::size_t invocations;  // Number of filter engine applications
+    std::size_t halo_pixels;  // Pixels read around blocks by the kernels
+  };
+
+  // Costs of the last filtering, before and after coalescing leaves of the
+  // quadtree
+  struct Statistics {
+    Cost leaves;
+    Cost blocks;
+  };
 
   // Constructors
   GradientFilter(const cv::Mat& kernel,
                  const cv::Size& size = cv::Size(),
                  double lower_range = 0.0,
                  double upper_range = 255.0);
+  GradientFilter(const Aperture& aperture,
+                 const cv::Size& size,
+                 double lower_range = 0.0,
+                 double upper_range = 255.0);
   GradientFilter(const GradientFilter& other);
 
   // Assignment
@@ -61,46 +85,208 @@ class GradientFilter : public Filter {
   // Performs filtering
   virtual void operator()(const cv::Mat& source, cv::Mat *destination) override;
 
-  // Matrix of gradient
+  // Performs filtering only in the rectangle of the source. The destination
+  // has the size of the rectangle. Pixels of the source are read only within
+  // the halo of the largest filter the gradient needs in the rectangle.
+  virtual void operator()(const cv::Mat& source,
+                          const cv::Rect& roi,
+                          cv::Mat *destination);
+
+  // Performs filtering of the sources of the same size with the gradient at
+  // once. The quadtree is built once, and every block is filtered for all
+  // the sources back to back while its kernels and gradient are in cache.
+  // Sources are filtered one by one in interactive mode.
+  virtual void operator()(const std::vector<cv::Mat>& sources,
+                          std::vector<cv::Mat> *destinations);
+
+  // Matrix of gradient, which may have lower resolution than images by the
+  // given scale, where every element covers the square of scale x scale
+  // pixels. Values between centers of the elements are interpolated
+  // bilinearly while compositing, without making the full resolution one.
   const cv::Mat& gradient() const { return gradient_; }
-  void set_gradient(const cv::Mat& value);
+  int gradient_scale() const { return gradient_scale_; }
+  void set_gradient(const cv::Mat& value, int scale = 1);
+
+  // Value of the gradient at the pixel of images
+  float SampleGradient(const cv::Point& point) const;
 
   // Value range for all the matrices to apply with
   const std::pair<double, double>& range() const { return range_; }
-  void set_range(const std::pair<double, double>& value) { range_ = value; }
+  void set_range(const std::pair<double, double>& value);
   void set_range(double min, double max);
 
+  // Whether to merge neighbouring leaves of the quadtree that need the same
+  // filters before filtering. Enabled by default.
+  bool coalesces_leaves() const { return coalesces_leaves_; }
+  void set_coalesces_leaves(bool value);
+
+  // Interactive mode retains blurred images of every level for the last
+  // source, and blocks of the quadtree for the current gradient, so that
+  // filtering the same source again with another gradient only redoes
+  // compositing. Blurred levels beyond the memory limit in bytes are dropped
+  // in least recently used order, or never when the limit is zero.
+  bool interactive() const { return static_cast<bool>(blur_stack_); }
+  void EnableInteractive(std::size_t memory_limit = 0,
+                         BlurStack::Precision precision =
+                             BlurStack::Precision::kFull);
+  virtual void DisableInteractive();
+
+  // Blurred levels retained in interactive mode, or null otherwise
+  const BlurStack *blur_stack() const { return blur_stack_.get(); }
+
+  // Discards everything retained in interactive mode. Call this after
+  // modifying contents of the source or the gradient in place.
+  virtual void InvalidateCache();
+
+  // Relative tolerance of weights regarded as equal when encoding kernels
+  // into runs of equal weight. Kernels made of long runs are filtered by the
+  // run-length engine, so a larger tolerance lets nearly binary kernels use
+  // it at the cost of approximating their weights. Zero by default, which
+  // picks a tolerance for kernels close to binary as RunStructure() does.
+  double run_tolerance() const { return run_tolerance_; }
+  void set_run_tolerance(double value);
+
+  // Engines measured fastest for kernels, which take precedence over the
+  // built-in choice of engines for the same kernels and tolerance of runs
+  const EngineProfile& engine_profile() const { return engine_profile_; }
+  void set_engine_profile(const EngineProfile& value);
+
+  // Whether the engine profile has measured every kernel of the filter
+  bool calibrated() const;
+
+  // Measures every engine that applies to each kernel by filtering tiles of
+  // the given size, and uses the fastest ones from then on. Save the
+  // resulting profile to skip measuring on later runs on the same host.
+  void Calibrate(const cv::Size& tile_size = cv::Size(256, 256),
+                 int repeat = 5);
+
+  // Kinds of engines used for all the value boundaries, from the smallest
+  const std::vector<Engine>& engines() const { return engines_; }
+
+  // Size of the largest kernel
+  const cv::Size& kernel_size() const {
+    return kernel_structures_.back().size();
+  }
+
+  // Normalized kernels for all the value boundaries, from the smallest
+  const std::vector<cv::Mat1f>& kernels() const { return kernels_; }
+
+  // Structures of the kernels for all the value boundaries, from the
+  // smallest
+  const std::vector<KernelStructure>& kernel_structures() const {
+    return kernel_structures_;
+  }
+
+  // Statistics of the last filtering
+  const Statistics& statistics() const { return statistics_; }
+
+  // Pool of intermediate matrices, shared with copies of this filter. Filters
+  // given the same workspace reuse each other's memory.
+  const std::shared_ptr<Workspace>& workspace() const { return workspace_; }
+  void set_workspace(const std::shared_ptr<Workspace>& value);
+
+ protected:
+  // Region of the source needed to filter the rectangle of it, which is the
+  // rectangle expanded by the halo of the largest filter used in it
+  cv::Rect SourceRegion(const cv::Size& size, const cv::Rect& roi) const;
+
+  // Filters the rectangle of the image, where the source in single precision
+  // covers the given region of the whole image
+  void Render(const cv::Mat3f& source,
+              const cv::Rect& region,
+              const cv::Rect& roi,
+              cv::Mat3f *destination);
+
+  // Filters the rectangle of the given number of images at once, sharing
+  // blocks of the quadtree
+  void Render(const cv::Mat3f *sources,
+              std::size_t count,
+              const cv::Rect& region,
+              const cv::Rect& roi,
+              cv::Mat3f *destinations);
+
  private:
-  // Builds filter engines for all the value boundaries
+  // Interval between value boundaries of the gradient
+  double interval() const;
+
+  // Builds filter engines for all the value boundaries by resampling the
+  // given kernel, or by rasterizing the aperture at every size
   void BuildFilters(const cv::Mat& kernel, const cv::Size& size);
+  void BuildFilters(const Aperture& aperture, const cv::Size& size);
+
+  // Builds filter engines for the given kernels ordered from the smallest
+  void BuildFilters(const std::vector<cv::Mat1f>& kernels);
 
-  // Recursively applies filters on partial region of the source defined by
-  // rectangle of the given quadrant nodes
-  void ApplyInRect(const Quadtree& tree,
+  // Builds filter engines of the most efficient kind for every kernel
+  void BuildEngines();
+
+  // Rectangle of elements of the gradient that covers the rectangle of
+  // pixels, and the inverse
+  cv::Rect GradientRect(const cv::Rect& rect) const;
+  cv::Rect ImageRect(const cv::Rect& rect) const;
+
+  // Interpolates values of the gradient in the row of the rectangle of
+  // pixels
+  void SampleGradient(const cv::Rect& rect, int y, float *values) const;
+
+  // Recursively collects leaves of the given quadrant nodes as blocks with
+  // the range of filter indices they need, clipped to the rectangle
+  void CollectBlocks(const Quadtree& tree,
+                     double interval,
+                     const cv::Rect& roi,
+                     std::vector<Block> *blocks) const;
+
+  // Estimates the cost of filtering the given blocks
+  Cost Measure(const std::vector<Block>& blocks) const;
+
+  // Applies filters on partial region of the source defined by rectangle of
+  // the given block. The source and the destination cover regions of the
+  // whole image starting at the given origins.
+  void ApplyInRect(const Block& block,
                    double interval,
                    const cv::Mat3f& source,
-                   const cv::Mat1f& gradient,
+                   const cv::Point& source_origin,
+                   const cv::Point& destination_origin,
                    cv::Mat3f *destination) const;
 
-  // Applies filter at the given index, and alpha-composite it with the
-  // underlay by the gradient as alpha
+  // Applies filter at the given index on the rectangle of the source, and
+  // alpha-composite it with the underlay by the gradient in the rectangle of
+  // the whole image as alpha
   void ApplyComposite(const cv::Mat3f& source,
+                      const cv::Rect& rect,
                       Index filter_index,
                       const cv::Mat3f& underlay,
-                      const cv::Mat1f& gradient,
+                      const cv::Rect& gradient_rect,
                       double lower_value,
                       double upper_value,
                       cv::Mat3f *destination) const;
 
-  // Applies filter at the given index
+  // Applies filter at the given index on the rectangle of the source
   void Apply(const cv::Mat3f& source,
+             const cv::Rect& rect,
              Index filter_index,
              cv::Mat3f *destination) const;
 
   // Data members
   cv::Mat1f gradient_;
+  cv::Mat1f gradient_min_;  // Lower bounds of values in every element
+  cv::Mat1f gradient_max_;  // Upper bounds of values in every element
+  int gradient_scale_;
   std::pair<double, double> range_;
   std::vector<cv::Ptr<cv::FilterEngine>> filters_;
+  std::vector<Engine> engines_;
+  EngineProfile engine_profile_;
+  std::vector<cv::Mat1f> kernels_;
+  std::vector<KernelStructure> kernel_structures_;
+  double run_tolerance_;
+  bool coalesces_leaves_;
+  Statistics statistics_;
+  std::unique_ptr<BlurStack> blur_stack_;
+  std::shared_ptr<Workspace> workspace_;
+  Quadtree tree_;
+  std::vector<Block> blocks_;
+  cv::Rect blocks_roi_;
+  bool blocks_valid_;
 };
 
 #pragma mark - Inline Implementations
@@ -109,37 +295,138 @@ inline GradientFilter::GradientFilter(const cv::Mat& kernel,
                                       const cv::Size& size,
                                       double lower_range,
                                       double upper_range)
-    : range_(lower_range, upper_range) {
+    : gradient_scale_(1),
+      range_(lower_range, upper_range),
+      run_tolerance_(),
+      coalesces_leaves_(true),
+      statistics_(),
+      workspace_(std::make_shared<Workspace>()),
+      tree_(),
+      blocks_valid_() {
   BuildFilters(kernel, size);
 }
 
+inline GradientFilter::GradientFilter(const Aperture& aperture,
+                                      const cv::Size& size,
+                                      double lower_range,
+                                      double upper_range)
+    : gradient_scale_(1),
+      range_(lower_range, upper_range),
+      run_tolerance_(),
+      coalesces_leaves_(true),
+      statistics_(),
+      workspace_(std::make_shared<Workspace>()),
+      tree_(),
+      blocks_valid_() {
+  BuildFilters(aperture, size);
+}
+
 inline GradientFilter::GradientFilter(const GradientFilter& other)
     : gradient_(other.gradient_),
+      gradient_min_(other.gradient_min_),
+      gradient_max_(other.gradient_max_),
+      gradient_scale_(other.gradient_scale_),
       range_(other.range_),
-      filters_(other.filters_) {}
+      filters_(other.filters_),
+      engines_(other.engines_),
+      engine_profile_(other.engine_profile_),
+      kernels_(other.kernels_),
+      kernel_structures_(other.kernel_structures_),
+      run_tolerance_(other.run_tolerance_),
+      coalesces_leaves_(other.coalesces_leaves_),
+      statistics_(other.statistics_),
+      blur_stack_(other.blur_stack_ ? new BlurStack(*other.blur_stack_)
+                                    : nullptr),
+      workspace_(other.workspace_),
+      tree_(other.tree_),
+      blocks_(other.blocks_),
+      blocks_roi_(other.blocks_roi_),
+      blocks_valid_(other.blocks_valid_) {}
 
 inline GradientFilter& GradientFilter::operator=(const GradientFilter& other) {
   if (&other != this) {
     gradient_ = other.gradient_;
+    gradient_min_ = other.gradient_min_;
+    gradient_max_ = other.gradient_max_;
+    gradient_scale_ = other.gradient_scale_;
     range_ = other.range_;
     filters_ = other.filters_;
+    engines_ = other.engines_;
+    engine_profile_ = other.engine_profile_;
+    kernels_ = other.kernels_;
+    kernel_structures_ = other.kernel_structures_;
+    run_tolerance_ = other.run_tolerance_;
+    coalesces_leaves_ = other.coalesces_leaves_;
+    statistics_ = other.statistics_;
+    blur_stack_.reset(other.blur_stack_ ? new BlurStack(*other.blur_stack_)
+                                        : nullptr);
+    workspace_ = other.workspace_;
+    tree_ = other.tree_;
+    blocks_ = other.blocks_;
+    blocks_roi_ = other.blocks_roi_;
+    blocks_valid_ = other.blocks_valid_;
   }
   return *this;
 }
 
-inline void GradientFilter::set_gradient(const cv::Mat& value) {
-  assert(value.channels() == 1);
-  if (value.depth() != cv::DataDepth<float>::value) {
-    value.convertTo(gradient_, cv::DataType<float>::type);
-  } else {
-    gradient_ = value;
-  }
+inline void GradientFilter::set_range(const std::pair<double, double>& value) {
+  range_ = value;
+  blocks_valid_ = false;
 }
 
 inline void GradientFilter::set_range(double min, double max) {
   set_range(std::pair<double, double>(min, max));
 }
 
+inline double GradientFilter::interval() const {
+  const double size = range_.second - range_.first;
+  assert(size);
+  return size / (filters_.size() + 1);
+}
+
+inline void GradientFilter::set_run_tolerance(double value) {
+  assert(value >= 0.0);
+  if (value != run_tolerance_) {
+    run_tolerance_ = value;
+    BuildEngines();
+    InvalidateCache();
+  }
+}
+
+inline void GradientFilter::set_engine_profile(const EngineProfile& value) {
+  engine_profile_ = value;
+  BuildEngines();
+  InvalidateCache();
+}
+
+inline void GradientFilter::set_coalesces_leaves(bool value) {
+  coalesces_leaves_ = value;
+  blocks_valid_ = false;
+}
+
+inline void GradientFilter::set_workspace(
+    const std::shared_ptr<Workspace>& value) {
+  assert(value);
+  workspace_ = value;
+}
+
+inline void GradientFilter::EnableInteractive(std::size_t memory_limit,
+                                              BlurStack::Precision precision) {
+  blur_stack_.reset(new BlurStack(memory_limit, precision));
+}
+
+inline void GradientFilter::DisableInteractive() {
+  blur_stack_.reset();
+  blocks_valid_ = false;
+}
+
+inline void GradientFilter::InvalidateCache() {
+  if (blur_stack_) {
+    blur_stack_->Clear();
+  }
+  blocks_valid_ = false;
+}
+
 }  // namespace sgss
 
 #endif  // __cplusplus
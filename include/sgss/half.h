@@ -0,0 +1,151 @@
+//
+//  sgss/half.h
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+#ifndef SGSS_HALF_H_
+#define SGSS_HALF_H_
+
+#ifdef __cplusplus
+
+#include <opencv2/opencv.hpp>
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+namespace sgss {
+namespace half {
+
+// Converts a single precision value to IEEE 754 half precision bits, rounding
+// to the nearest even
+inline std::uint16_t Encode(float value) {
+  std::uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const std::uint32_t sign = (bits >> 16) & 0x8000;
+  const std::uint32_t magnitude = bits & 0x7fffffff;
+  if (magnitude >= 0x7f800000) {
+    // Infinity or NaN
+    return sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x0200 : 0);
+  }
+  if (magnitude >= 0x477ff000) {
+    // Rounds beyond the largest finite half value
+    return sign | 0x7c00;
+  }
+  if (magnitude < 0x33000000) {
+    // Rounds to zero
+    return sign;
+  }
+  std::uint32_t result;
+  std::uint32_t remainder;
+  std::uint32_t halfway;
+  if (magnitude < 0x38800000) {
+    // Subnormal half value
+    const std::uint32_t shift = 126 - (magnitude >> 23);
+    const std::uint32_t mantissa = (magnitude & 0x007fffff) | 0x00800000;
+    result = mantissa >> shift;
+    remainder = mantissa & ((1u << shift) - 1);
+    halfway = 1u << (shift - 1);
+  } else {
+    result = (magnitude - 0x38000000) >> 13;
+    remainder = magnitude & 0x1fff;
+    halfway = 0x1000;
+  }
+  if (remainder > halfway || (remainder == halfway && (result & 1))) {
+    ++result;
+  }
+  return sign | result;
+}
+
+// Converts IEEE 754 half precision bits to a single precision value
+inline float Decode(std::uint16_t value) {
+  const std::uint32_t sign = static_cast<std::uint32_t>(value & 0x8000) << 16;
+  std::uint32_t exponent = (value >> 10) & 0x1f;
+  std::uint32_t mantissa = value & 0x03ff;
+  std::uint32_t bits;
+  if (exponent == 0x1f) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent) {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  } else if (!mantissa) {
+    bits = sign;
+  } else {
+    // Normalize subnormal half value
+    exponent = 113;
+    while (!(mantissa & 0x0400)) {
+      mantissa <<= 1;
+      --exponent;
+    }
+    bits = sign | (exponent << 23) | ((mantissa & 0x03ff) << 13);
+  }
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+// Converts a single precision matrix to a 16-bit unsigned matrix of the same
+// number of channels holding half precision bits. A destination of that size
+// and type is written in place.
+inline void Encode(const cv::Mat& source, cv::Mat *destination) {
+  assert(destination);
+  assert(source.depth() == cv::DataDepth<float>::value);
+  destination->create(source.size(),
+                      CV_MAKETYPE(cv::DataDepth<std::uint16_t>::value,
+                                  source.channels()));
+  const int count = source.cols * source.channels();
+  for (int y = 0; y < source.rows; ++y) {
+    const float *source_row = source.ptr<float>(y);
+    std::uint16_t *destination_row = destination->ptr<std::uint16_t>(y);
+    for (int x = 0; x < count; ++x) {
+      destination_row[x] = Encode(source_row[x]);
+    }
+  }
+}
+
+// Converts a matrix of half precision bits to a single precision matrix of
+// the same number of channels. A destination of that size and type is
+// written in place.
+inline void Decode(const cv::Mat& source, cv::Mat *destination) {
+  assert(destination);
+  assert(source.depth() == cv::DataDepth<std::uint16_t>::value);
+  destination->create(source.size(),
+                      CV_MAKETYPE(cv::DataDepth<float>::value,
+                                  source.channels()));
+  const int count = source.cols * source.channels();
+  for (int y = 0; y < source.rows; ++y) {
+    const std::uint16_t *source_row = source.ptr<std::uint16_t>(y);
+    float *destination_row = destination->ptr<float>(y);
+    for (int x = 0; x < count; ++x) {
+      destination_row[x] = Decode(source_row[x]);
+    }
+  }
+}
+
+}  // namespace half
+}  // namespace sgss
+
+#endif  // __cplusplus
+
+#endif  // SGSS_HALF_H_
@@ -0,0 +1,97 @@
+//
+//  sgss/kernel_structure.h
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+#ifndef SGSS_KERNEL_STRUCTURE_H_
+#define SGSS_KERNEL_STRUCTURE_H_
+
+#ifdef __cplusplus
+
+#include <opencv2/opencv.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace sgss {
+
+class KernelStructure {
+ public:
+  // Horizontal run of taps of equal weight
+  struct Run {
+    int x;
+    int length;
+    float weight;
+  };
+  using Row = std::vector<Run>;
+
+  // Constructors
+  KernelStructure();
+  explicit KernelStructure(const cv::Mat1f& kernel, double tolerance = 1e-6);
+
+  // Size of the kernel analyzed
+  const cv::Size& size() const { return size_; }
+
+  // Whether the kernel is mirrored across its vertical and horizontal axes
+  bool horizontally_symmetric() const { return horizontally_symmetric_; }
+  bool vertically_symmetric() const { return vertically_symmetric_; }
+
+  // Whether the kernel is the outer product of the column and row kernels
+  bool separable() const { return separable_; }
+  const cv::Mat1f& row_kernel() const { return row_kernel_; }
+  const cv::Mat1f& column_kernel() const { return column_kernel_; }
+
+  // Runs of nonzero taps in every row of the kernel
+  const std::vector<Row>& runs() const { return runs_; }
+  std::size_t run_count() const { return run_count_; }
+  std::size_t nonzero_count() const { return nonzero_count_; }
+
+ private:
+  // Data members
+  cv::Size size_;
+  bool horizontally_symmetric_;
+  bool vertically_symmetric_;
+  bool separable_;
+  cv::Mat1f row_kernel_;
+  cv::Mat1f column_kernel_;
+  std::vector<Row> runs_;
+  std::size_t run_count_;
+  std::size_t nonzero_count_;
+};
+
+#pragma mark - Inline Implementations
+
+inline KernelStructure::KernelStructure()
+    : horizontally_symmetric_(),
+      vertically_symmetric_(),
+      separable_(),
+      run_count_(),
+      nonzero_count_() {}
+
+}  // namespace sgss
+
+#endif  // __cplusplus
+
+#endif  // SGSS_KERNEL_STRUCTURE_H_
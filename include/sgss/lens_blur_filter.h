@@ -32,6 +32,10 @@
 
 #include <opencv2/opencv.hpp>
 
+#include <cstddef>
+#include <vector>
+
+#include "sgss/aperture.h"
 #include "sgss/gradient_filter.h"
 
 namespace sgss {
@@ -40,6 +44,7 @@ class LensBlurFilter : public GradientFilter {
  public:
   // Constructors
   LensBlurFilter(const cv::Mat& kernel, const cv::Size& size = cv::Size());
+  LensBlurFilter(const Aperture& aperture, const cv::Size& size);
   LensBlurFilter(const LensBlurFilter& other);
 
   // Assignment
@@ -47,14 +52,57 @@ class LensBlurFilter : public GradientFilter {
 
   // Performs filtering
   virtual void operator()(const cv::Mat& source, cv::Mat *destination);
+  virtual void operator()(const cv::Mat& source,
+                          const cv::Rect& roi,
+                          cv::Mat *destination);
+  virtual void operator()(const std::vector<cv::Mat>& sources,
+                          std::vector<cv::Mat> *destinations);
 
   // Brightness of specular highlight. Negative or zero for no effect.
   float brightness() const { return brightness_; }
   void set_brightness(float value) { brightness_ = value; }
 
+  // Size of tiles to filter the destination in, or empty to filter it at
+  // once. Every tile is exponentiated with its halo, filtered, and taken
+  // logarithm into the destination in turn, so that intermediate images
+  // stay in cache and are never made for the whole image. A tile with its
+  // halo should fit in the L2 cache with a few copies, which is around
+  // 128 x 128 for the largest kernel of 27 x 27 and 1 MB of cache. Batches
+  // are filtered in the same tiles, so a tile of every image of a batch with
+  // its halo should fit instead. Not used in interactive mode, and
+  // statistics are of the last tile.
+  const cv::Size& tile_size() const { return tile_size_; }
+  void set_tile_size(const cv::Size& value) { tile_size_ = value; }
+
+  // Leaves interactive mode, and discards everything retained in it
+  virtual void DisableInteractive() override;
+
+  // Discards everything retained in interactive mode
+  virtual void InvalidateCache() override;
+
  private:
+  // Filters the rectangle of the given number of sources of the same size
+  // tile by tile, where every tile of all the sources is filtered at once
+  void RenderTiles(const cv::Mat *sources,
+                   std::size_t count,
+                   const cv::Rect& roi,
+                   const cv::Size& tile_size,
+                   cv::Mat *destinations);
+
+  // Converts the source to single precision, and raises it to exponential
+  // by the brightness
+  void Exponentiate(const cv::Mat& source, cv::Mat3f *destination) const;
+
+  // Takes logarithm of the exponential image in place, and converts it to
+  // the destination of the given depth
+  void Logarithm(cv::Mat3f *source, int depth, cv::Mat *destination) const;
+
   // Data members
   float brightness_;
+  cv::Size tile_size_;
+  cv::Mat source_key_;
+  cv::Mat3f source_exp_;
+  float source_exp_brightness_;
 };
 
 #pragma mark - Inline Implementations
@@ -62,20 +110,49 @@ class LensBlurFilter : public GradientFilter {
 inline LensBlurFilter::LensBlurFilter(const cv::Mat& kernel,
                                       const cv::Size& size)
     : GradientFilter(kernel, size),
-      brightness_(1.0) {}
+      brightness_(1.0),
+      tile_size_(),
+      source_exp_brightness_() {}
+
+inline LensBlurFilter::LensBlurFilter(const Aperture& aperture,
+                                      const cv::Size& size)
+    : GradientFilter(aperture, size),
+      brightness_(1.0),
+      tile_size_(),
+      source_exp_brightness_() {}
 
 inline LensBlurFilter::LensBlurFilter(const LensBlurFilter& other)
     : GradientFilter(other),
-      brightness_(other.brightness_) {}
+      brightness_(other.brightness_),
+      tile_size_(other.tile_size_),
+      source_key_(other.source_key_),
+      source_exp_(other.source_exp_),
+      source_exp_brightness_(other.source_exp_brightness_) {}
 
 inline LensBlurFilter& LensBlurFilter::operator=(const LensBlurFilter& other) {
   GradientFilter::operator=(other);
   if (&other != this) {
     brightness_ = other.brightness_;
+    tile_size_ = other.tile_size_;
+    source_key_ = other.source_key_;
+    source_exp_ = other.source_exp_;
+    source_exp_brightness_ = other.source_exp_brightness_;
   }
   return *this;
 }
 
+inline void LensBlurFilter::DisableInteractive() {
+  GradientFilter::DisableInteractive();
+  source_key_.release();
+  source_exp_.release();
+}
+
+inline void LensBlurFilter::InvalidateCache() {
+  GradientFilter::InvalidateCache();
+  source_key_.release();
+  source_exp_.release();
+}
+
 }  // namespace sgss
 
 #endif  // __cplusplus
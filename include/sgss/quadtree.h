@@ -52,12 +52,24 @@ class Quadtree {
   // Assignment
   Quadtree& operator=(const Quadtree& other);
 
+  // Makes this node an empty leaf of the given rectangle. Memory of quadrant
+  // nodes is kept for reuse by the next insertion.
+  void Reset(const cv::Rect& rect);
+
   // Inserts all elements in the given single-channel matrix
   void Insert(const cv::Mat& matrix,
               double interval,
               const cv::Size& size_limit = cv::Size(8, 8),
               std::size_t max_span = 2);
 
+  // Inserts lower and upper bounds of values of every element, given in two
+  // single-channel matrices of the same size
+  void Insert(const cv::Mat& min_matrix,
+              const cv::Mat& max_matrix,
+              double interval,
+              const cv::Size& size_limit = cv::Size(8, 8),
+              std::size_t max_span = 2);
+
   // Getting information about this node
   Level level() const { return level_; }
   const cv::Rect& rect() const { return rect_; }
@@ -67,16 +79,19 @@ class Quadtree {
   double min_value() const { return min_value_; }
   double max_value() const { return max_value_; }
 
-  // Iterator to quadrant nodes
-  Storage::const_iterator begin() const { return nodes_.begin(); }
+  // Iterator to quadrant nodes, which are none for leaves
+  Storage::const_iterator begin() const;
   Storage::const_iterator end() const { return nodes_.end(); }
-  Storage::const_iterator cbegin() const { return nodes_.cbegin(); }
+  Storage::const_iterator cbegin() const { return begin(); }
   Storage::const_iterator cend() const { return nodes_.cend(); }
 
  private:
   // Constructors
   Quadtree(Level level, const cv::Rect& rect);
 
+  // Makes this node an empty leaf of the given level and rectangle
+  void Reset(Level level, const cv::Rect& rect);
+
   // Subdivides this quadtree
   void Subdivide();
 
@@ -125,7 +140,7 @@ inline Quadtree::Quadtree(const Quadtree& other)
       min_value_(other.min_value_),
       max_value_(other.max_value_),
       nodes_() {
-  for (const auto& node : other.nodes_) {
+  for (const auto& node : other) {
     nodes_.emplace_back(new Quadtree(*node));
   }
 }
@@ -138,13 +153,29 @@ inline Quadtree& Quadtree::operator=(const Quadtree& other) {
     min_value_ = other.min_value_;
     max_value_ = other.max_value_;
     nodes_.clear();
-    for (const auto& node : other.nodes_) {
+    for (const auto& node : other) {
       nodes_.emplace_back(new Quadtree(*node));
     }
   }
   return *this;
 }
 
+inline void Quadtree::Reset(const cv::Rect& rect) {
+  Reset(level_, rect);
+}
+
+inline void Quadtree::Reset(Level level, const cv::Rect& rect) {
+  level_ = level;
+  rect_ = rect;
+  empty_ = true;
+  min_value_ = 0.0;
+  max_value_ = 0.0;
+}
+
+inline Quadtree::Storage::const_iterator Quadtree::begin() const {
+  return empty_ ? nodes_.end() : nodes_.begin();
+}
+
 }  // namespace sgss
 
 #endif  // __cplusplus
@@ -0,0 +1,68 @@
+//
+//  sgss/reference.h
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+#ifndef SGSS_REFERENCE_H_
+#define SGSS_REFERENCE_H_
+
+#ifdef __cplusplus
+
+#include <opencv2/opencv.hpp>
+
+namespace sgss {
+
+class GradientFilter;
+class LensBlurFilter;
+
+namespace reference {
+
+// Filters the source with the same kernels, range and gradient as the given
+// filter, but determines filters for every pixel independently and convolves
+// them directly in double precision. This is slow, and is meant to measure
+// errors of the optimized filters.
+void Render(const GradientFilter& filter,
+            const cv::Mat& source,
+            cv::Mat *destination);
+void Render(const LensBlurFilter& filter,
+            const cv::Mat& source,
+            cv::Mat *destination);
+
+// Differences between values of two matrices of the same size and number of
+// channels, over all the channels
+struct Difference {
+  double max;
+  double mean;
+  double rms;
+};
+
+Difference Compare(const cv::Mat& a, const cv::Mat& b);
+
+}  // namespace reference
+}  // namespace sgss
+
+#endif  // __cplusplus
+
+#endif  // SGSS_REFERENCE_H_
@@ -0,0 +1,130 @@
+//
+//  sgss/render_protocol.h
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+#ifndef SGSS_RENDER_PROTOCOL_H_
+#define SGSS_RENDER_PROTOCOL_H_
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sgss {
+namespace render {
+
+// Messages exchanged with the render daemon over a Unix domain socket. Every
+// message is a fixed-size structure in the byte order of the host. Frames
+// are never sent in messages. Instead, file descriptors of shared memory
+// holding them, made by memfd or shm_open for instance, are passed along
+// with render requests, and the daemon maps them without copying.
+
+const std::uint32_t kMagic = 0x52534753;  // "SGSR"
+
+enum class MessageType : std::uint32_t {
+  kRender = 1,      // Filters a frame
+  kStatistics = 2,  // Reports queue depth and latencies
+};
+
+enum class Status : std::uint32_t {
+  kOK = 0,
+  kInvalidRequest = 1,  // Malformed request or unknown filter
+  kInvalidFrame = 2,    // Frames missing, too small, or failed to map
+  kBusy = 3,            // The queue is full
+};
+
+// Request to filter a frame, followed by file descriptors of the source, the
+// destination and optionally the gradient, in this order. Pixels start at
+// offset zero of every descriptor and continue without padding. The source
+// and destination are 3 channels of the same type, and the gradient is a
+// single channel of any depth, of lower resolution by the scale if greater
+// than one.
+struct Request {
+  std::uint32_t magic;
+  std::uint32_t type;  // MessageType
+  std::uint64_t id;    // Echoed back in the response
+  std::int32_t filter;  // Index of the filter prepared by the daemon
+  std::int32_t width;
+  std::int32_t height;
+  std::int32_t frame_type;  // OpenCV type of the source and destination
+  std::int32_t gradient_width;  // Zero for no gradient
+  std::int32_t gradient_height;
+  std::int32_t gradient_type;
+  std::int32_t gradient_scale;
+  float brightness;
+  std::uint32_t reserved;
+};
+
+// Response to a render request, sent when the destination is written
+struct Response {
+  std::uint32_t magic;
+  std::uint32_t status;  // Status
+  std::uint64_t id;
+  double queue_seconds;   // Time waited in the queue
+  double render_seconds;  // Time taken for filtering
+};
+
+// Response to a statistics request. Latencies from receiving requests to
+// sending responses are of the recent requests taken by workers. Requests
+// rejected by a full queue count as failed, but have no latencies.
+struct Statistics {
+  std::uint32_t magic;
+  std::uint32_t status;  // Status
+  std::uint64_t completed;
+  std::uint64_t failed;
+  std::uint32_t queue_depth;
+  std::uint32_t workers;
+  double latency_p50;
+  double latency_p90;
+  double latency_p99;
+  double latency_max;
+};
+
+// Maximum number of file descriptors passed with a message
+const std::size_t kMaxDescriptors = 3;
+
+// Sends the message with the file descriptors, and returns false on error
+bool Send(int socket,
+          const void *message,
+          std::size_t size,
+          const int *descriptors = nullptr,
+          std::size_t descriptor_count = 0);
+
+// Receives a message of the given size, and file descriptors passed with it
+// up to kMaxDescriptors. Returns false on error or end of the stream, in
+// which case the caller still owns descriptors received so far.
+bool Receive(int socket,
+             void *message,
+             std::size_t size,
+             int *descriptors = nullptr,
+             std::size_t *descriptor_count = nullptr);
+
+}  // namespace render
+}  // namespace sgss
+
+#endif  // __cplusplus
+
+#endif  // SGSS_RENDER_PROTOCOL_H_
@@ -0,0 +1,159 @@
+//
+//  sgss/render_server.h
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+#ifndef SGSS_RENDER_SERVER_H_
+#define SGSS_RENDER_SERVER_H_
+
+#ifdef __cplusplus
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "sgss/lens_blur_filter.h"
+#include "sgss/render_protocol.h"
+
+namespace sgss {
+namespace render {
+
+// Server of the render protocol, which accepts requests from any number of
+// clients on a Unix domain socket, and filters them on a pool of workers.
+// Every worker owns filters made by the given factories once at start, so
+// that kernels, engines and workspaces stay warm across requests. Factories
+// must construct new filters rather than return copies of one, because
+// copies share filter engines that are not safe to use from many threads.
+class Server {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using FilterFactory = std::function<LensBlurFilter()>;
+
+  // Constructors
+  Server(const std::string& path,
+         const std::vector<FilterFactory>& factories,
+         std::size_t worker_count,
+         std::size_t queue_limit = 256);
+  Server(const Server& other) = delete;
+  ~Server();
+
+  // Assignment
+  Server& operator=(const Server& other) = delete;
+
+  // Binds the socket and starts the workers, and returns false on error
+  bool Start();
+
+  // Accepts connections until stopped. Call after starting.
+  void Run();
+
+  // Makes Run return, and stops the workers. Safe to call from signal
+  // handlers, where it only requests to stop.
+  void Stop();
+
+  // Statistics of the requests so far
+  Statistics statistics() const;
+
+ private:
+  // Socket of a client shared by the connection and the jobs from it
+  struct Connection {
+    explicit Connection(int socket)
+        : socket(socket), closed(false), dropped(false) {}
+    ~Connection();
+    int socket;
+    std::mutex mutex;  // Serializes responses from workers
+    std::atomic<bool> closed;  // Whether the client disconnected
+    bool dropped;  // Whether sending failed, guarded by the mutex
+  };
+
+  // Render request waiting in the queue
+  struct Job {
+    std::shared_ptr<Connection> connection;
+    Request request;
+    int descriptors[kMaxDescriptors];
+    std::size_t descriptor_count;
+    Clock::time_point received;
+  };
+
+  // Closes the socket, and joins all the threads
+  void Shutdown();
+
+  // Reads requests from the client until it disconnects
+  void Serve(std::shared_ptr<Connection> connection);
+
+  // Sends the response to the client of the connection
+  void Respond(Connection *connection, const Response& response);
+
+  // Sends the message to the client of the connection. A client that
+  // doesn't read it in time is dropped, so that workers never wait for it.
+  void Reply(Connection *connection, const void *data, std::size_t size);
+
+  // Takes jobs from the queue until stopped
+  void Work();
+
+  // Filters the frames of the job with the filters of the worker
+  Status Process(const Job& job, std::vector<LensBlurFilter> *filters);
+
+  // Records the latency of a finished job
+  void Record(bool succeeded, double latency);
+
+  // Counts a request rejected by a full queue as failed, leaving its
+  // latency out of the percentiles, which are of filtered requests only
+  void RecordRejection();
+
+  // Data members
+  std::string path_;
+  std::vector<FilterFactory> factories_;
+  std::size_t worker_count_;
+  std::size_t queue_limit_;
+  int socket_;
+  std::atomic<bool> stopping_;
+  std::vector<std::thread> workers_;
+  std::vector<std::pair<std::thread, std::shared_ptr<Connection>>> clients_;
+  mutable std::mutex queue_mutex_;
+  std::condition_variable queue_condition_;
+  std::deque<Job> queue_;
+  mutable std::mutex statistics_mutex_;
+  std::uint64_t completed_;
+  std::uint64_t failed_;
+  std::vector<double> latencies_;  // Ring of recent latencies
+  std::size_t latency_index_;
+};
+
+}  // namespace render
+}  // namespace sgss
+
+#endif  // __cplusplus
+
+#endif  // SGSS_RENDER_SERVER_H_
@@ -0,0 +1,82 @@
+//
+//  sgss/run_length_filter.h
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+#ifndef SGSS_RUN_LENGTH_FILTER_H_
+#define SGSS_RUN_LENGTH_FILTER_H_
+
+#ifdef __cplusplus
+
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+
+#include "sgss/kernel_structure.h"
+
+namespace sgss {
+
+// Two-dimensional filter of single precision images that convolves every run
+// of equal weight in rows of the kernel at once, by differences of prefix
+// sums of source rows. A kernel of runs bounded in number per row, like a
+// flat disc, costs O(height) per pixel instead of O(width * height), and
+// zero taps cost nothing.
+class RunLengthFilter : public cv::BaseFilter {
+ public:
+  // Constructors
+  explicit RunLengthFilter(const KernelStructure& structure);
+
+  // Filters the given number of rows
+  virtual void operator()(const uchar **source,
+                          uchar *destination,
+                          int destination_step,
+                          int count,
+                          int width,
+                          int channels) override;
+
+  // Forgets the prefix sums of the previous image
+  virtual void reset() override;
+
+ private:
+  // Data members
+  std::vector<KernelStructure::Row> runs_;
+  std::vector<std::vector<double>> prefix_sums_;  // Ring of source rows
+  std::vector<int> prefix_rows_;  // Source row of each entry of the ring
+  std::vector<const uchar *> prefix_sources_;
+  int row_;  // Source row of the first row of the next call
+  std::vector<double> sums_;
+};
+
+// Creates a filter engine of the run-length filter for the given type of
+// single precision images
+cv::Ptr<cv::FilterEngine> CreateRunLengthFilter(
+    const KernelStructure& structure,
+    int type);
+
+}  // namespace sgss
+
+#endif  // __cplusplus
+
+#endif  // SGSS_RUN_LENGTH_FILTER_H_
@@ -0,0 +1,154 @@
+//
+//  sgss/tiled_image.h
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+#ifndef SGSS_TILED_IMAGE_H_
+#define SGSS_TILED_IMAGE_H_
+
+#ifdef __cplusplus
+
+#include <opencv2/opencv.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace sgss {
+
+// Raw image file made of a header followed by fixed-size tiles in row-major
+// order, which is memory-mapped rather than decoded. Tiles at the right and
+// bottom edges are padded to the full tile size. Floating-point images can
+// be stored in half precision. Values are in the byte order of the host.
+class TiledImage {
+ public:
+  // Constructors
+  TiledImage();
+  TiledImage(const TiledImage& other) = delete;
+  ~TiledImage();
+
+  // Assignment
+  TiledImage& operator=(const TiledImage& other) = delete;
+
+  // Creates a file of the given layout and maps it for reading and writing.
+  // Returns false when the file cannot be created.
+  bool Create(const std::string& path,
+              const cv::Size& size,
+              int type,
+              const cv::Size& tile_size = cv::Size(256, 256),
+              bool half_precision = false);
+
+  // Maps an existing file. Returns false when the file cannot be opened or
+  // is not a tiled image.
+  bool Open(const std::string& path, bool writable = false);
+
+  // Unmaps the file
+  void Close();
+
+  // Attributes
+  bool is_open() const { return data_ != nullptr; }
+  bool writable() const { return writable_; }
+  const cv::Size& size() const { return size_; }
+  int type() const { return type_; }
+  const cv::Size& tile_size() const { return tile_size_; }
+  bool half_precision() const { return half_precision_; }
+
+  // Type of elements as stored in tiles
+  int storage_type() const;
+
+  // Number of tiles in columns and rows
+  cv::Size grid_size() const;
+
+  // Rectangle of the tile at the given column and row of the grid, clipped
+  // by bounds of the image
+  cv::Rect TileRect(int column, int row) const;
+
+  // Matrix of the storage type referring to the tile in the mapped memory
+  // without copying it. Writing to it requires the file to be writable.
+  cv::Mat Tile(int column, int row) const;
+
+  // Reads the rectangle of the image. The destination refers to the mapped
+  // memory without copying when the rectangle lies within a single tile
+  // stored in full precision, and is a copy otherwise.
+  void Read(const cv::Rect& rect, cv::Mat *destination) const;
+
+  // Writes the source to the rectangle of the image
+  void Write(const cv::Rect& rect, const cv::Mat& source);
+
+ private:
+  // Maps the file of the given length
+  bool Map(int descriptor, std::size_t length, bool writable);
+
+  // Data members
+  std::uint8_t *data_;
+  std::size_t length_;
+  bool writable_;
+  cv::Size size_;
+  int type_;
+  cv::Size tile_size_;
+  bool half_precision_;
+  std::size_t tile_bytes_;
+  std::size_t data_offset_;
+};
+
+#pragma mark - Inline Implementations
+
+inline TiledImage::TiledImage()
+    : data_(nullptr),
+      length_(),
+      writable_(),
+      type_(),
+      half_precision_(),
+      tile_bytes_(),
+      data_offset_() {}
+
+inline TiledImage::~TiledImage() {
+  Close();
+}
+
+inline int TiledImage::storage_type() const {
+  if (half_precision_) {
+    return CV_MAKETYPE(cv::DataDepth<std::uint16_t>::value,
+                       CV_MAT_CN(type_));
+  }
+  return type_;
+}
+
+inline cv::Size TiledImage::grid_size() const {
+  return cv::Size((size_.width - 1) / tile_size_.width + 1,
+                  (size_.height - 1) / tile_size_.height + 1);
+}
+
+inline cv::Rect TiledImage::TileRect(int column, int row) const {
+  const cv::Rect rect(column * tile_size_.width, row * tile_size_.height,
+                      tile_size_.width, tile_size_.height);
+  return rect & cv::Rect(cv::Point(), size_);
+}
+
+}  // namespace sgss
+
+#endif  // __cplusplus
+
+#endif  // SGSS_TILED_IMAGE_H_
@@ -0,0 +1,51 @@
+//
+//  sgss/tiled_render.h
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+#ifndef SGSS_TILED_RENDER_H_
+#define SGSS_TILED_RENDER_H_
+
+#ifdef __cplusplus
+
+namespace sgss {
+
+class GradientFilter;
+class TiledImage;
+
+// Applies the filter to the source tile by tile, reading the tiles of the
+// source and the gradient around every destination tile with a halo as large
+// as the largest kernel. The gradient can be null to filter without it. The
+// gradient previously set to the filter is restored afterwards.
+void RenderTiled(GradientFilter *filter,
+                 const TiledImage& source,
+                 const TiledImage *gradient,
+                 TiledImage *destination);
+
+}  // namespace sgss
+
+#endif  // __cplusplus
+
+#endif  // SGSS_TILED_RENDER_H_
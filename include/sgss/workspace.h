@@ -0,0 +1,175 @@
+//
+//  sgss/workspace.h
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#pragma once
+#ifndef SGSS_WORKSPACE_H_
+#define SGSS_WORKSPACE_H_
+
+#ifdef __cplusplus
+
+#include <opencv2/opencv.hpp>
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace sgss {
+
+// Pool of memory blocks for intermediate matrices, grouped in size classes.
+// Blocks returned to the pool are kept for later requests of the same class,
+// so that repeated filtering of images of the same size allocates no memory
+// after the first time. Safe to share between threads.
+class Workspace {
+ public:
+  // Matrix leased from the workspace, whose memory returns to it when the
+  // buffer is destroyed. The workspace must outlive its buffers.
+  class Buffer {
+   public:
+    // Constructors
+    Buffer();
+    Buffer(Buffer&& other);
+    Buffer(const Buffer& other) = delete;
+    ~Buffer();
+
+    // Assignment
+    Buffer& operator=(Buffer&& other);
+    Buffer& operator=(const Buffer& other) = delete;
+
+    // Matrix referring to the leased memory
+    const cv::Mat& mat() const { return mat_; }
+
+   private:
+    friend class Workspace;
+
+    // Returns the memory to the workspace
+    void Release();
+
+    // Data members
+    Workspace *workspace_;
+    void *block_;
+    std::size_t capacity_;
+    cv::Mat mat_;
+  };
+
+  // Constructors
+  Workspace();
+  Workspace(const Workspace& other) = delete;
+  ~Workspace();
+
+  // Assignment
+  Workspace& operator=(const Workspace& other) = delete;
+
+  // Leases a continuous matrix of the given size and type
+  Buffer Acquire(const cv::Size& size, int type);
+
+  // Frees all the blocks not leased
+  void Trim();
+
+  // Bytes of blocks held by the pool, either leased or not
+  std::size_t capacity() const;
+
+  // Bytes leased at the same time at most
+  std::size_t high_water_mark() const;
+
+  // Number of blocks allocated from the heap so far
+  std::size_t allocation_count() const;
+
+ private:
+  // Takes the block back into the pool
+  void Return(void *block, std::size_t capacity);
+
+  // Data members
+  mutable std::mutex mutex_;
+  std::map<std::size_t, std::vector<void *>> free_blocks_;
+  std::size_t capacity_;
+  std::size_t leased_;
+  std::size_t high_water_mark_;
+  std::size_t allocation_count_;
+};
+
+#pragma mark - Inline Implementations
+
+inline Workspace::Buffer::Buffer()
+    : workspace_(nullptr),
+      block_(nullptr),
+      capacity_() {}
+
+inline Workspace::Buffer::Buffer(Buffer&& other)
+    : workspace_(other.workspace_),
+      block_(other.block_),
+      capacity_(other.capacity_),
+      mat_(other.mat_) {
+  other.workspace_ = nullptr;
+  other.block_ = nullptr;
+  other.capacity_ = 0;
+  other.mat_ = cv::Mat();
+}
+
+inline Workspace::Buffer::~Buffer() {
+  Release();
+}
+
+inline Workspace::Buffer& Workspace::Buffer::operator=(Buffer&& other) {
+  if (&other != this) {
+    Release();
+    workspace_ = other.workspace_;
+    block_ = other.block_;
+    capacity_ = other.capacity_;
+    mat_ = other.mat_;
+    other.workspace_ = nullptr;
+    other.block_ = nullptr;
+    other.capacity_ = 0;
+    other.mat_ = cv::Mat();
+  }
+  return *this;
+}
+
+inline void Workspace::Buffer::Release() {
+  if (workspace_ && block_) {
+    workspace_->Return(block_, capacity_);
+  }
+  workspace_ = nullptr;
+  block_ = nullptr;
+  capacity_ = 0;
+  mat_ = cv::Mat();
+}
+
+inline Workspace::Workspace()
+    : capacity_(),
+      leased_(),
+      high_water_mark_(),
+      allocation_count_() {}
+
+inline Workspace::~Workspace() {
+  Trim();
+}
+
+}  // namespace sgss
+
+#endif  // __cplusplus
+
+#endif  // SGSS_WORKSPACE_H_
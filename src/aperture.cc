@@ -0,0 +1,149 @@
+//
+//  sgss/aperture.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include "sgss/aperture.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+namespace sgss {
+
+namespace {
+
+// Number of vertices of polygons approximating circles
+const int kCircleVertices = 256;
+
+// Clips the convex polygon by the half plane where the coordinate on the
+// given axis is greater (or less when upper is true) than the boundary
+void Clip(const std::vector<cv::Point2d>& polygon,
+          bool vertical,
+          bool upper,
+          double boundary,
+          std::vector<cv::Point2d> *result) {
+  assert(result);
+  result->clear();
+  if (polygon.empty()) {
+    return;
+  }
+  const auto distance = [&](const cv::Point2d& point) {
+    const double value = vertical ? point.y : point.x;
+    return upper ? boundary - value : value - boundary;
+  };
+  cv::Point2d previous = polygon.back();
+  double previous_distance = distance(previous);
+  for (const auto& current : polygon) {
+    const double current_distance = distance(current);
+    if ((previous_distance >= 0.0) != (current_distance >= 0.0)) {
+      const double t = previous_distance /
+                       (previous_distance - current_distance);
+      result->emplace_back(previous.x + (current.x - previous.x) * t,
+                           previous.y + (current.y - previous.y) * t);
+    }
+    if (current_distance >= 0.0) {
+      result->push_back(current);
+    }
+    previous = current;
+    previous_distance = current_distance;
+  }
+}
+
+// Computes the area of the polygon by the shoelace formula
+double Area(const std::vector<cv::Point2d>& polygon) {
+  double area = 0.0;
+  for (std::size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+    area += polygon[j].x * polygon[i].y - polygon[i].x * polygon[j].y;
+  }
+  return std::abs(area) * 0.5;
+}
+
+// Accumulates the area of every pixel covered by the convex polygon centered
+// in the matrix, multiplied by the given weight
+void Accumulate(const std::vector<cv::Point2d>& polygon,
+                double weight,
+                cv::Mat1f *matrix) {
+  assert(matrix);
+  const double origin_x = matrix->cols * 0.5;
+  const double origin_y = matrix->rows * 0.5;
+  std::vector<cv::Point2d> row;
+  std::vector<cv::Point2d> pixel;
+  std::vector<cv::Point2d> buffer;
+  for (int y = 0; y < matrix->rows; ++y) {
+    // Clip the polygon by the row first, and then by every pixel in the row.
+    Clip(polygon, true, false, y - origin_y, &buffer);
+    Clip(buffer, true, true, y + 1 - origin_y, &row);
+    if (row.empty()) {
+      continue;
+    }
+    for (int x = 0; x < matrix->cols; ++x) {
+      Clip(row, false, false, x - origin_x, &buffer);
+      Clip(buffer, false, true, x + 1 - origin_x, &pixel);
+      if (pixel.size() >= 3) {
+        (*matrix)(y, x) += weight * Area(pixel);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+cv::Mat1f Aperture::Rasterize(const cv::Size& size) const {
+  assert(size.width > 0 && size.height > 0);
+  cv::Mat1f result(size, 0.0f);
+  const cv::Size2d outer_size(size.width, size.height);
+  Accumulate(Outline(outer_size), 1.0, &result);
+  if (shape_ == Shape::kRing && inner_ratio_ > 0.0) {
+    const cv::Size2d inner_size(outer_size.width * inner_ratio_,
+                                outer_size.height * inner_ratio_);
+    Accumulate(Outline(inner_size), -1.0, &result);
+    cv::max(result, 0.0, result);
+  }
+  return result;
+}
+
+std::vector<cv::Point2d> Aperture::Outline(const cv::Size2d& size) const {
+  int count = blades_;
+  double radius = 1.0;
+  if (shape_ != Shape::kPolygon) {
+    // Enlarge the polygon approximating the circle so that both areas equal.
+    count = kCircleVertices;
+    const double step = 2.0 * M_PI / count;
+    radius = std::sqrt(step / std::sin(step));
+  }
+  std::vector<cv::Point2d> result;
+  for (int i = 0; i < count; ++i) {
+    // Start from the top vertex, which points up when not rotated.
+    const double angle = rotation_ - M_PI * 0.5 + 2.0 * M_PI * i / count;
+    result.emplace_back(std::cos(angle) * radius * size.width * 0.5,
+                        std::sin(angle) * radius * size.height * 0.5);
+  }
+  return result;
+}
+
+}  // namespace sgss
@@ -0,0 +1,111 @@
+//
+//  sgss/block.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include "sgss/block.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace sgss {
+
+namespace {
+
+// Merges each run of blocks that share the same row (or column when
+// vertical is true) and abut one another, in a single sweep
+std::size_t MergeRuns(std::vector<Block> *blocks, bool vertical) {
+  assert(blocks);
+  // Transposes coordinates so that the sweep always runs along x
+  const auto major = [vertical](const cv::Rect& rect) {
+    return vertical ? rect.x : rect.y;
+  };
+  const auto minor = [vertical](const cv::Rect& rect) {
+    return vertical ? rect.y : rect.x;
+  };
+  const auto thickness = [vertical](const cv::Rect& rect) {
+    return vertical ? rect.width : rect.height;
+  };
+  const auto length = [vertical](const cv::Rect& rect) {
+    return vertical ? rect.height : rect.width;
+  };
+  std::sort(blocks->begin(), blocks->end(),
+            [&](const Block& a, const Block& b) {
+    if (major(a.rect) != major(b.rect)) {
+      return major(a.rect) < major(b.rect);
+    }
+    if (thickness(a.rect) != thickness(b.rect)) {
+      return thickness(a.rect) < thickness(b.rect);
+    }
+    return minor(a.rect) < minor(b.rect);
+  });
+  std::size_t merged = 0;
+  std::vector<Block>::iterator last = blocks->begin();
+  for (auto block = blocks->begin(); block != blocks->end(); ++block) {
+    if (block == last) {
+      continue;
+    }
+    if (major(last->rect) == major(block->rect) &&
+        thickness(last->rect) == thickness(block->rect) &&
+        minor(last->rect) + length(last->rect) == minor(block->rect) &&
+        last->SpansEqual(*block)) {
+      if (vertical) {
+        last->rect.height += block->rect.height;
+      } else {
+        last->rect.width += block->rect.width;
+      }
+      ++merged;
+    } else {
+      *++last = *block;
+    }
+  }
+  if (!blocks->empty()) {
+    blocks->erase(last + 1, blocks->end());
+  }
+  return merged;
+}
+
+}  // namespace
+
+std::size_t CoalesceBlocks(std::vector<Block> *blocks) {
+  assert(blocks);
+  // Alternate horizontal and vertical sweeps, since merging in one direction
+  // can line up blocks to be merged in the other.
+  std::size_t total = 0;
+  bool vertical = false;
+  std::size_t idle_sweeps = 0;
+  while (idle_sweeps < 2) {
+    const std::size_t merged = MergeRuns(blocks, vertical);
+    idle_sweeps = merged ? 0 : idle_sweeps + 1;
+    total += merged;
+    vertical = !vertical;
+  }
+  return total;
+}
+
+}  // namespace sgss
@@ -0,0 +1,125 @@
+//
+//  sgss/blur_stack.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include "sgss/blur_stack.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "sgss/half.h"
+
+namespace sgss {
+
+bool SharesData(const cv::Mat& a, const cv::Mat& b) {
+  return a.data == b.data &&
+         a.size() == b.size() &&
+         a.step == b.step &&
+         a.type() == b.type();
+}
+
+const cv::Mat3f& BlurStack::Bind(const cv::Mat& source) {
+  assert(!source.empty());
+  assert(source.channels() == 3);
+  // Holding the key keeps its data alive, so that no other matrix can be
+  // allocated at the same address while the levels are retained. Binding
+  // the source returned also keeps the levels.
+  if (!SharesData(source, key_) && !SharesData(source, source_)) {
+    Clear();
+    key_ = source;
+    if (source.depth() != cv::DataDepth<float>::value) {
+      source.convertTo(source_, cv::DataType<float>::type);
+    } else {
+      source_ = source;
+    }
+  }
+  return source_;
+}
+
+void BlurStack::Clear() {
+  key_.release();
+  source_.release();
+  entries_.clear();
+  memory_usage_ = 0;
+}
+
+bool BlurStack::Fetch(Index index, const cv::Rect& rect,
+                      cv::Mat3f *destination) {
+  assert(destination);
+  assert(destination->size() == rect.size());
+  for (auto entry = entries_.begin(); entry != entries_.end(); ++entry) {
+    if (entry->index != index) {
+      continue;
+    }
+    entries_.splice(entries_.begin(), entries_, entry);
+    const cv::Mat level_roi(entry->level, rect);
+    if (precision_ == Precision::kHalf) {
+      for (int y = 0; y < rect.height; ++y) {
+        const std::uint16_t *source_row = level_roi.ptr<std::uint16_t>(y);
+        float *destination_row = destination->ptr<float>(y);
+        for (int x = 0; x < rect.width * 3; ++x) {
+          destination_row[x] = half::Decode(source_row[x]);
+        }
+      }
+    } else {
+      level_roi.copyTo(*destination);
+    }
+    return true;
+  }
+  return false;
+}
+
+void BlurStack::Store(Index index, const cv::Mat3f& level) {
+  assert(level.size() == source_.size());
+  for (auto entry = entries_.begin(); entry != entries_.end(); ++entry) {
+    if (entry->index == index) {
+      memory_usage_ -= entry->level.total() * entry->level.elemSize();
+      entries_.erase(entry);
+      break;
+    }
+  }
+  Entry entry;
+  entry.index = index;
+  if (precision_ == Precision::kHalf) {
+    half::Encode(level, &entry.level);
+  } else {
+    entry.level = level;
+  }
+  memory_usage_ += entry.level.total() * entry.level.elemSize();
+  entries_.push_front(entry);
+
+  // Drop least recently used levels, but always keep the one just stored.
+  while (memory_limit_ && memory_usage_ > memory_limit_ &&
+         entries_.size() > 1) {
+    const Entry& last = entries_.back();
+    memory_usage_ -= last.level.total() * last.level.elemSize();
+    entries_.pop_back();
+  }
+}
+
+}  // namespace sgss
@@ -0,0 +1,333 @@
+//
+//  sgss/engine.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include "sgss/engine.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <string>
+
+#include "sgss/fixed_size_filter.h"
+#include "sgss/kernel_structure.h"
+#include "sgss/run_length_filter.h"
+
+namespace sgss {
+
+namespace {
+
+const Engine kEngines[] = {
+  Engine::kGeneric,
+  Engine::kSeparable,
+  Engine::kRunLength,
+  Engine::kFixedSize,
+};
+
+// Tolerance of runs tried for kernels close to binary, and the largest error
+// of their weights relative to the sum of weights
+const double kBinaryRunTolerance = 0.1;
+const double kBinaryRunError = 0.05;
+
+std::string HostName() {
+  char name[256] = {};
+  if (gethostname(name, sizeof(name) - 1)) {
+    return std::string();
+  }
+  return name;
+}
+
+// Hashes the size and weights of the kernel and the tolerance of runs by
+// FNV-1a, which is stable across runs on the same host
+std::uint64_t KernelKey(const cv::Mat1f& kernel, double run_tolerance) {
+  std::uint64_t hash = 14695981039346656037ULL;
+  const auto append = [&hash](const void *data, std::size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+      hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+  };
+  const std::int32_t size[] = { kernel.cols, kernel.rows };
+  append(size, sizeof(size));
+  for (int y = 0; y < kernel.rows; ++y) {
+    append(kernel[y], kernel.cols * sizeof(float));
+  }
+  append(&run_tolerance, sizeof(run_tolerance));
+  return hash;
+}
+
+// Formats keys as hexadecimal strings, since cv::FileStorage doesn't store
+// 64-bit integers
+std::string FormatKey(std::uint64_t key) {
+  char string[17] = {};
+  std::snprintf(string, sizeof(string), "%016llx",
+                static_cast<unsigned long long>(key));
+  return string;
+}
+
+bool ParseKey(const std::string& string, std::uint64_t *key) {
+  assert(key);
+  if (string.size() != 16 ||
+      string.find_first_not_of("0123456789abcdef") != std::string::npos) {
+    return false;
+  }
+  *key = std::strtoull(string.c_str(), nullptr, 16);
+  return true;
+}
+
+}  // namespace
+
+const char *EngineName(Engine engine) {
+  switch (engine) {
+    case Engine::kGeneric: return "generic";
+    case Engine::kSeparable: return "separable";
+    case Engine::kRunLength: return "run_length";
+    case Engine::kFixedSize: return "fixed_size";
+  }
+  assert(false);
+  return "";
+}
+
+bool EngineFromName(const std::string& name, Engine *engine) {
+  assert(engine);
+  for (const auto candidate : kEngines) {
+    if (name == EngineName(candidate)) {
+      *engine = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+cv::Ptr<cv::FilterEngine> CreateFilterEngine(
+    const cv::Ptr<cv::BaseFilter>& filter,
+    int type) {
+  assert(!filter.empty());
+  return cv::Ptr<cv::FilterEngine>(new cv::FilterEngine(
+      filter,
+      cv::Ptr<cv::BaseRowFilter>(),
+      cv::Ptr<cv::BaseColumnFilter>(),
+      type, type, type,
+      cv::BORDER_REFLECT_101));
+}
+
+KernelStructure RunStructure(const cv::Mat1f& kernel,
+                             const KernelStructure& structure,
+                             double tolerance) {
+  if (tolerance > 0.0) {
+    return KernelStructure(kernel, tolerance);
+  }
+  if (HasLongRuns(structure)) {
+    return structure;
+  }
+  const KernelStructure binary_structure(kernel, kBinaryRunTolerance);
+  if (!HasLongRuns(binary_structure)) {
+    return structure;
+  }
+  // Taps that runs skip count as errors of their whole weights.
+  cv::Mat1f approximation(kernel.size(), 0.0f);
+  for (int y = 0; y < kernel.rows; ++y) {
+    for (const auto& run : binary_structure.runs()[y]) {
+      for (int x = run.x; x < run.x + run.length; ++x) {
+        approximation(y, x) = run.weight;
+      }
+    }
+  }
+  const double error = cv::norm(kernel, approximation, cv::NORM_L1);
+  if (error > kBinaryRunError * cv::norm(kernel, cv::NORM_L1)) {
+    return structure;
+  }
+  return binary_structure;
+}
+
+bool HasLongRuns(const KernelStructure& run_structure) {
+  // Every run costs two lookups of prefix sums, which is cheaper than
+  // multiplying all of its taps when runs are long on average.
+  return run_structure.run_count() * 2 < run_structure.nonzero_count();
+}
+
+cv::Ptr<cv::FilterEngine> CreateEngine(Engine engine,
+                                       const cv::Mat1f& kernel,
+                                       const KernelStructure& structure,
+                                       const KernelStructure& run_structure,
+                                       int type) {
+  switch (engine) {
+    case Engine::kGeneric:
+      return cv::createLinearFilter(type, type, kernel);
+    case Engine::kSeparable:
+      if (!structure.separable()) {
+        break;
+      }
+      return cv::createSeparableLinearFilter(
+          type, type, structure.row_kernel(), structure.column_kernel());
+    case Engine::kRunLength:
+      return CreateRunLengthFilter(run_structure, type);
+    case Engine::kFixedSize:
+      return CreateFixedSizeFilter(kernel, type);
+  }
+  return cv::Ptr<cv::FilterEngine>();
+}
+
+cv::Ptr<cv::FilterEngine> CreateDefaultEngine(
+    const cv::Mat1f& kernel,
+    const KernelStructure& structure,
+    const KernelStructure& run_structure,
+    int type,
+    Engine *engine) {
+  assert(engine);
+  // Small kernels are fastest with taps unrolled for their size. Separable
+  // kernels cost O(width + height) per pixel instead of O(width * height).
+  const Engine candidates[] = {
+    Engine::kFixedSize,
+    Engine::kSeparable,
+    HasLongRuns(run_structure) ? Engine::kRunLength : Engine::kGeneric,
+    Engine::kGeneric,
+  };
+  for (const auto candidate : candidates) {
+    const cv::Ptr<cv::FilterEngine> filter(
+        CreateEngine(candidate, kernel, structure, run_structure, type));
+    if (!filter.empty()) {
+      *engine = candidate;
+      return filter;
+    }
+  }
+  assert(false);
+  return cv::Ptr<cv::FilterEngine>();
+}
+
+Engine MeasureFastestEngine(const cv::Mat1f& kernel,
+                            const KernelStructure& structure,
+                            const KernelStructure& run_structure,
+                            const cv::Size& tile_size,
+                            int repeat) {
+  assert(tile_size.area() > 0);
+  assert(repeat > 0);
+  const int type = cv::DataType<cv::Vec3f>::type;
+  cv::Mat3f source(tile_size);
+  cv::randu(source, cv::Scalar::all(0.0), cv::Scalar::all(1.0));
+  cv::Mat3f destination(tile_size);
+  Engine fastest_engine = Engine::kGeneric;
+  int64 fastest_time = std::numeric_limits<int64>::max();
+  for (const auto engine : kEngines) {
+    const cv::Ptr<cv::FilterEngine> filter(
+        CreateEngine(engine, kernel, structure, run_structure, type));
+    if (filter.empty()) {
+      continue;
+    }
+    // Take the shortest of the repeated runs after warming up, which is the
+    // least disturbed by other processes.
+    filter->apply(source, destination);
+    int64 time = std::numeric_limits<int64>::max();
+    for (int i = 0; i < repeat; ++i) {
+      const int64 start = cv::getTickCount();
+      filter->apply(source, destination);
+      time = std::min(time, cv::getTickCount() - start);
+    }
+    if (time < fastest_time) {
+      fastest_engine = engine;
+      fastest_time = time;
+    }
+  }
+  return fastest_engine;
+}
+
+EngineProfile::EngineProfile() : host_(HostName()) {}
+
+bool EngineProfile::Find(const cv::Mat1f& kernel,
+                         double run_tolerance,
+                         Engine *engine) const {
+  assert(engine);
+  const auto found = entries_.find(KernelKey(kernel, run_tolerance));
+  if (found == entries_.end()) {
+    return false;
+  }
+  *engine = found->second.engine;
+  return true;
+}
+
+void EngineProfile::Insert(const cv::Mat1f& kernel,
+                           double run_tolerance,
+                           Engine engine) {
+  entries_[KernelKey(kernel, run_tolerance)] = Entry{kernel.size(), engine};
+}
+
+bool EngineProfile::Load(const std::string& path) {
+  cv::FileStorage storage;
+  if (!storage.open(path, cv::FileStorage::READ)) {
+    return false;
+  }
+  if (static_cast<std::string>(storage["host"]) != HostName()) {
+    return false;
+  }
+  const cv::FileNode nodes = storage["engines"];
+  if (!nodes.isSeq()) {
+    return false;
+  }
+  std::map<std::uint64_t, Entry> entries;
+  for (auto it = nodes.begin(); it != nodes.end(); ++it) {
+    const cv::FileNode node = *it;
+    std::uint64_t key;
+    Entry entry;
+    if (!ParseKey(node["key"], &key) ||
+        !EngineFromName(node["engine"], &entry.engine)) {
+      return false;
+    }
+    entry.size.width = node["width"];
+    entry.size.height = node["height"];
+    entries[key] = entry;
+  }
+  host_ = HostName();
+  entries_.swap(entries);
+  return true;
+}
+
+bool EngineProfile::Save(const std::string& path) const {
+  cv::FileStorage storage;
+  if (!storage.open(path, cv::FileStorage::WRITE)) {
+    return false;
+  }
+  storage << "host" << host_;
+  storage << "engines" << "[";
+  for (const auto& pair : entries_) {
+    storage << "{";
+    storage << "key" << FormatKey(pair.first);
+    storage << "width" << pair.second.size.width;
+    storage << "height" << pair.second.size.height;
+    storage << "engine" << EngineName(pair.second.engine);
+    storage << "}";
+  }
+  storage << "]";
+  return true;
+}
+
+}  // namespace sgss
@@ -0,0 +1,73 @@
+//
+//  sgss/fixed_size_filter.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include "sgss/fixed_size_filter.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cassert>
+
+#include "sgss/engine.h"
+
+namespace sgss {
+
+namespace {
+
+// Instantiates filters of square kernels up to 7 x 7. Larger kernels are
+// cheaper with the separable or run-length filters, and unrolling them only
+// bloats the code.
+template <int Channels>
+cv::BaseFilter *CreateFilter(const cv::Mat1f& kernel) {
+  if (kernel.cols != kernel.rows) {
+    return nullptr;
+  }
+  switch (kernel.cols) {
+    case 1: return new FixedSizeFilter<1, 1, Channels>(kernel);
+    case 3: return new FixedSizeFilter<3, 3, Channels>(kernel);
+    case 5: return new FixedSizeFilter<5, 5, Channels>(kernel);
+    case 7: return new FixedSizeFilter<7, 7, Channels>(kernel);
+    default: return nullptr;
+  }
+}
+
+}  // namespace
+
+cv::Ptr<cv::FilterEngine> CreateFixedSizeFilter(const cv::Mat1f& kernel,
+                                                int type) {
+  assert(CV_MAT_DEPTH(type) == cv::DataDepth<float>::value);
+  cv::BaseFilter *filter = nullptr;
+  switch (CV_MAT_CN(type)) {
+    case 1: filter = CreateFilter<1>(kernel); break;
+    case 3: filter = CreateFilter<3>(kernel); break;
+    default: break;
+  }
+  if (!filter) {
+    return cv::Ptr<cv::FilterEngine>();
+  }
+  return CreateFilterEngine(cv::Ptr<cv::BaseFilter>(filter), type);
+}
+
+}  // namespace sgss
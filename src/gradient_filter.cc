@@ -33,33 +33,294 @@
 #include <cmath>
 #include <cstdint>
 #include <utility>
+#include <vector>
 
+#include "sgss/block.h"
 #include "sgss/color.h"
+#include "sgss/engine.h"
 #include "sgss/quadtree.h"
+#include "sgss/workspace.h"
 
 namespace sgss {
 
+namespace {
+
+// Two elements of the gradient to interpolate between, and the weight of the
+// latter
+struct Interpolation {
+  int lower;
+  int upper;
+  float weight;
+};
+
+// Locates the pixel between centers of elements of the given scale, where
+// pixels beyond the outermost centers take values of the outermost elements
+Interpolation Locate(int pixel, int scale, int count) {
+  const float position = (pixel + 0.5f) / scale - 0.5f;
+  if (position <= 0.0f) {
+    return Interpolation{0, 0, 0.0f};
+  }
+  const int lower = position;
+  if (lower >= count - 1) {
+    return Interpolation{count - 1, count - 1, 0.0f};
+  }
+  return Interpolation{lower, lower + 1, position - lower};
+}
+
+}  // namespace
+
 void GradientFilter::operator()(const cv::Mat& source, cv::Mat *destination) {
+  (*this)(source, cv::Rect(cv::Point(), source.size()), destination);
+}
+
+void GradientFilter::operator()(const cv::Mat& source,
+                                const cv::Rect& roi,
+                                cv::Mat *destination) {
   assert(!source.empty());
   assert(source.channels() == 3);
-  const cv::Mat *source_ptr = &source;
+  assert((roi & cv::Rect(cv::Point(), source.size())) == roi);
+  assert(destination);
+  const cv::Rect region = SourceRegion(source.size(), roi);
+  const int type = cv::DataType<cv::Vec3f>::type;
+  Workspace::Buffer source_buffer;
   cv::Mat3f inter_source;
-  if (source.depth() != cv::DataDepth<float>::value) {
-    source.convertTo(inter_source, cv::DataType<float>::type);
-    source_ptr = &inter_source;
+  if (blur_stack_) {
+    inter_source = blur_stack_->Bind(source);
+  } else if (source.depth() != cv::DataDepth<float>::value) {
+    source_buffer = workspace_->Acquire(region.size(), type);
+    inter_source = source_buffer.mat();
+    cv::Mat(source, region).convertTo(inter_source, cv::DataType<float>::type);
+  } else {
+    inter_source = cv::Mat(source, region);
+  }
+  if (source.type() == type && destination->datastart != source.datastart) {
+    // Render directly into the destination when it needs no conversion and
+    // doesn't overlap the source.
+    destination->create(roi.size(), type);
+    cv::Mat3f inter_destination(*destination);
+    Render(inter_source, region, roi, &inter_destination);
+  } else {
+    Workspace::Buffer destination_buffer(workspace_->Acquire(roi.size(), type));
+    cv::Mat3f inter_destination(destination_buffer.mat());
+    Render(inter_source, region, roi, &inter_destination);
+    inter_destination.convertTo(*destination, source.type());
+  }
+}
+
+void GradientFilter::operator()(const std::vector<cv::Mat>& sources,
+                                std::vector<cv::Mat> *destinations) {
+  assert(destinations);
+  const std::size_t count = sources.size();
+  destinations->resize(count);
+  if (blur_stack_) {
+    // Retained levels are made from one source at a time.
+    for (std::size_t i = 0; i < count; ++i) {
+      (*this)(sources[i], &(*destinations)[i]);
+    }
+    return;
+  }
+  if (sources.empty()) {
+    return;
+  }
+  const cv::Rect roi(cv::Point(), sources.front().size());
+  const cv::Rect region = SourceRegion(roi.size(), roi);
+  const int type = cv::DataType<cv::Vec3f>::type;
+  std::vector<Workspace::Buffer> buffers;
+  buffers.reserve(count * 2);
+  // Every block is rendered for all the images in turn, so a destination
+  // written directly could overwrite a source that another image still
+  // reads. When any destination shares data with any source, all of them are
+  // rendered into buffers, as in the batch path of LensBlurFilter.
+  bool in_place = false;
+  for (const auto& source : sources) {
+    for (const auto& destination : *destinations) {
+      in_place = in_place || destination.datastart == source.datastart;
+    }
+  }
+  std::vector<cv::Mat3f> inter_sources(count);
+  std::vector<cv::Mat3f> inter_destinations(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    const cv::Mat& source = sources[i];
+    cv::Mat& destination = (*destinations)[i];
+    assert(source.size() == roi.size());
+    assert(source.channels() == 3);
+    if (source.depth() != cv::DataDepth<float>::value) {
+      buffers.push_back(workspace_->Acquire(region.size(), type));
+      inter_sources[i] = buffers.back().mat();
+      cv::Mat(source, region).convertTo(inter_sources[i],
+                                        cv::DataType<float>::type);
+    } else {
+      inter_sources[i] = cv::Mat(source, region);
+    }
+    if (source.type() == type && !in_place) {
+      destination.create(roi.size(), type);
+      inter_destinations[i] = destination;
+    } else {
+      buffers.push_back(workspace_->Acquire(roi.size(), type));
+      inter_destinations[i] = buffers.back().mat();
+    }
+  }
+  Render(inter_sources.data(), count, region, roi, inter_destinations.data());
+  for (std::size_t i = 0; i < count; ++i) {
+    cv::Mat& destination = (*destinations)[i];
+    if (inter_destinations[i].data != destination.data) {
+      inter_destinations[i].convertTo(destination, sources[i].type());
+    }
+  }
+}
+
+cv::Rect GradientFilter::SourceRegion(const cv::Size& size,
+                                      const cv::Rect& roi) const {
+  const cv::Rect bounds(cv::Point(), size);
+  if (blur_stack_) {
+    return bounds;  // Retained levels are made from the whole source
+  }
+  // Only the largest filter used in the rectangle determines the halo.
+  Index filter_index = filters_.size() - 1;
+  if (!gradient_.empty()) {
+    assert(gradient_.cols == (size.width + gradient_scale_ - 1) /
+                             gradient_scale_);
+    assert(gradient_.rows == (size.height + gradient_scale_ - 1) /
+                             gradient_scale_);
+    double max_value;
+    cv::minMaxIdx(cv::Mat(gradient_max_, GradientRect(roi)),
+                  nullptr, &max_value);
+    filter_index = std::min<Index>(
+        std::ceil(max_value / interval()),
+        filters_.size()) - 1;
+  }
+  if (filter_index < 0) {
+    return roi;
+  }
+  const cv::Size& ksize = kernel_structures_.at(filter_index).size();
+  return bounds & cv::Rect(roi.x - ksize.width / 2,
+                           roi.y - ksize.height / 2,
+                           roi.width + ksize.width - 1,
+                           roi.height + ksize.height - 1);
+}
+
+void GradientFilter::Render(const cv::Mat3f& source,
+                            const cv::Rect& region,
+                            const cv::Rect& roi,
+                            cv::Mat3f *destination) {
+  Render(&source, 1, region, roi, destination);
+}
+
+void GradientFilter::Render(const cv::Mat3f *sources,
+                            std::size_t count,
+                            const cv::Rect& region,
+                            const cv::Rect& roi,
+                            cv::Mat3f *destinations) {
+  assert(sources);
+  assert(destinations);
+  for (std::size_t i = 0; i < count; ++i) {
+    assert(sources[i].size() == region.size());
+    assert(destinations[i].size() == roi.size());
+  }
+  if (blur_stack_) {
+    assert(count == 1);
+    assert(region.tl() == cv::Point());
+    blur_stack_->Bind(sources[0]);
   }
-  cv::Mat3f inter_destination(source.size());
   if (gradient_.empty()) {
-    filters_.back()->apply(*source_ptr, inter_destination);
+    for (std::size_t i = 0; i < count; ++i) {
+      Apply(sources[i], roi - region.tl(), filters_.size() - 1,
+            &destinations[i]);
+    }
+    return;
+  }
+  const double interval = this->interval();
+  if (!blur_stack_ || !blocks_valid_ || blocks_roi_ != roi) {
+    // Nodes of the tree and storage of the blocks are kept across calls, so
+    // that they are allocated only when the gradient gets more complex. The
+    // tree is built on elements of the gradient, which are as small as
+    // pixels unless the gradient has lower resolution.
+    const int size_limit = std::max(8 / gradient_scale_, 1);
+    tree_.Reset(GradientRect(roi));
+    tree_.Insert(gradient_min_, gradient_max_, interval,
+                 cv::Size(size_limit, size_limit));
+    blocks_.clear();
+    CollectBlocks(tree_, interval, roi, &blocks_);
+    statistics_.leaves = Measure(blocks_);
+    if (coalesces_leaves_) {
+      CoalesceBlocks(&blocks_);
+    }
+    statistics_.blocks = Measure(blocks_);
+    blocks_roi_ = roi;
+    blocks_valid_ = true;
+  }
+  for (const auto& block : blocks_) {
+    for (std::size_t i = 0; i < count; ++i) {
+      ApplyInRect(block, interval, sources[i], region.tl(), roi.tl(),
+                  &destinations[i]);
+    }
+  }
+}
+
+void GradientFilter::set_gradient(const cv::Mat& value, int scale) {
+  assert(value.channels() == 1);
+  assert(scale > 0);
+  if (value.depth() != cv::DataDepth<float>::value) {
+    value.convertTo(gradient_, cv::DataType<float>::type);
+  } else {
+    gradient_ = value;
+  }
+  gradient_scale_ = scale;
+  if (scale > 1 && !gradient_.empty()) {
+    // Values interpolated in the pixels an element covers lie between the
+    // values of the element and its eight neighbours.
+    cv::erode(gradient_, gradient_min_, cv::Mat());
+    cv::dilate(gradient_, gradient_max_, cv::Mat());
   } else {
-    const double size = range_.second - range_.first;
-    assert(size);
-    const double interval = size / (filters_.size() + 1);
-    Quadtree tree(source.size());
-    tree.Insert(gradient_, interval);
-    ApplyInRect(tree, interval, *source_ptr, gradient_, &inter_destination);
+    gradient_min_ = gradient_;
+    gradient_max_ = gradient_;
+  }
+  blocks_valid_ = false;
+}
+
+float GradientFilter::SampleGradient(const cv::Point& point) const {
+  assert(!gradient_.empty());
+  if (gradient_scale_ == 1) {
+    return gradient_(point);
+  }
+  float value;
+  SampleGradient(cv::Rect(point, cv::Size(1, 1)), point.y, &value);
+  return value;
+}
+
+cv::Rect GradientFilter::GradientRect(const cv::Rect& rect) const {
+  if (gradient_scale_ == 1) {
+    return rect;
+  }
+  const int scale = gradient_scale_;
+  const int x = rect.x / scale;
+  const int y = rect.y / scale;
+  return cv::Rect(x, y,
+                  (rect.x + rect.width + scale - 1) / scale - x,
+                  (rect.y + rect.height + scale - 1) / scale - y);
+}
+
+cv::Rect GradientFilter::ImageRect(const cv::Rect& rect) const {
+  const int scale = gradient_scale_;
+  return cv::Rect(rect.x * scale, rect.y * scale,
+                  rect.width * scale, rect.height * scale);
+}
+
+void GradientFilter::SampleGradient(const cv::Rect& rect, int y,
+                                    float *values) const {
+  assert(values);
+  const int scale = gradient_scale_;
+  const Interpolation row = Locate(y, scale, gradient_.rows);
+  const float *top_row = gradient_[row.lower];
+  const float *bottom_row = gradient_[row.upper];
+  for (int x = 0; x < rect.width; ++x) {
+    const Interpolation column = Locate(rect.x + x, scale, gradient_.cols);
+    const float top = top_row[column.lower] +
+        (top_row[column.upper] - top_row[column.lower]) * column.weight;
+    const float bottom = bottom_row[column.lower] +
+        (bottom_row[column.upper] - bottom_row[column.lower]) * column.weight;
+    values[x] = top + (bottom - top) * row.weight;
   }
-  inter_destination.convertTo(*destination, source.type());
 }
 
 void GradientFilter::BuildFilters(const cv::Mat& kernel, const cv::Size& size) {
@@ -78,36 +339,99 @@ void GradientFilter::BuildFilters(const cv::Mat& kernel, const cv::Size& size) {
     kernel_size = size;
   }
   assert(kernel_size.width % 2 == 1 && kernel_size.height % 2 == 1);
-  assert(filters_.empty());
+  std::vector<cv::Mat1f> kernels;
   while (kernel_size.width > 0 && kernel_size.height > 0) {
     cv::Mat1f subkernel;
     cv::resize(*kernel_ptr, subkernel, kernel_size, 0.0, 0.0, cv::INTER_AREA);
-    cv::normalize(subkernel, subkernel, 1.0, 0.0, cv::NORM_L1);
-    filters_.push_back(cv::createLinearFilter(
-        cv::DataType<cv::Vec3f>::type,
-        cv::DataType<cv::Vec3f>::type,
-        subkernel));
+    kernels.push_back(subkernel);
     kernel_size.width -= 2;
     kernel_size.height -= 2;
   }
-  std::reverse(filters_.begin(), filters_.end());
+  std::reverse(kernels.begin(), kernels.end());
+  BuildFilters(kernels);
 }
 
-void GradientFilter::ApplyInRect(const Quadtree& tree, double interval,
-                                 const cv::Mat3f& source,
-                                 const cv::Mat1f& gradient,
-                                 cv::Mat3f *destination) const {
+void GradientFilter::BuildFilters(const Aperture& aperture,
+                                  const cv::Size& size) {
+  cv::Size kernel_size(size);
+  assert(kernel_size.width % 2 == 1 && kernel_size.height % 2 == 1);
+  std::vector<cv::Mat1f> kernels;
+  while (kernel_size.width > 0 && kernel_size.height > 0) {
+    kernels.push_back(aperture.Rasterize(kernel_size));
+    kernel_size.width -= 2;
+    kernel_size.height -= 2;
+  }
+  std::reverse(kernels.begin(), kernels.end());
+  BuildFilters(kernels);
+}
+
+void GradientFilter::BuildFilters(const std::vector<cv::Mat1f>& kernels) {
+  assert(!kernels.empty());
+  assert(kernels_.empty());
+  for (const auto& kernel : kernels) {
+    cv::Mat1f subkernel;
+    cv::normalize(kernel, subkernel, 1.0, 0.0, cv::NORM_L1);
+    kernels_.push_back(subkernel);
+  }
+  BuildEngines();
+}
+
+void GradientFilter::BuildEngines() {
+  filters_.clear();
+  engines_.clear();
+  kernel_structures_.clear();
+  const int type = cv::DataType<cv::Vec3f>::type;
+  for (const auto& kernel : kernels_) {
+    const KernelStructure structure(kernel);
+    const KernelStructure run_structure(
+        RunStructure(kernel, structure, run_tolerance_));
+    Engine engine;
+    cv::Ptr<cv::FilterEngine> filter;
+    if (engine_profile_.Find(kernel, run_tolerance_, &engine)) {
+      filter = CreateEngine(engine, kernel, structure, run_structure, type);
+    }
+    if (filter.empty()) {
+      filter = CreateDefaultEngine(kernel, structure, run_structure, type,
+                                   &engine);
+    }
+    filters_.push_back(filter);
+    engines_.push_back(engine);
+    kernel_structures_.push_back(structure);
+  }
+}
+
+void GradientFilter::Calibrate(const cv::Size& tile_size, int repeat) {
+  for (const auto& kernel : kernels_) {
+    const KernelStructure structure(kernel);
+    const KernelStructure run_structure(
+        RunStructure(kernel, structure, run_tolerance_));
+    engine_profile_.Insert(kernel, run_tolerance_, MeasureFastestEngine(
+        kernel, structure, run_structure, tile_size, repeat));
+  }
+  BuildEngines();
+  InvalidateCache();
+}
+
+bool GradientFilter::calibrated() const {
+  Engine engine;
+  for (const auto& kernel : kernels_) {
+    if (!engine_profile_.Find(kernel, run_tolerance_, &engine)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void GradientFilter::CollectBlocks(const Quadtree& tree, double interval,
+                                   const cv::Rect& roi,
+                                   std::vector<Block> *blocks) const {
+  assert(blocks);
   if (!tree.empty()) {
     for (const auto& node : tree) {
       assert(node);
-      ApplyInRect(*node, interval, source, gradient, destination);
+      CollectBlocks(*node, interval, roi, blocks);
     }
   } else {
-    const cv::Rect& rect = tree.rect();
-    const cv::Mat3f source_roi(source, rect);
-    const cv::Mat1f gradient_roi(gradient, rect);
-    cv::Mat3f destination_roi(*destination, rect);
-
     // Determine filter indices for the lower and upper value boundaries.
     // This could be negative when the source image doesn't need to be
     // filtered.
@@ -118,76 +442,167 @@ void GradientFilter::ApplyInRect(const Quadtree& tree, double interval,
         std::ceil(tree.max_value() / interval),
         filters_.size()) - 1;
     assert(lower_index <= upper_index);
+    blocks->emplace_back(ImageRect(tree.rect()) & roi,
+                         lower_index, upper_index);
+  }
+}
 
-    if (upper_index < 0) {
-      // The maximum value of the gradient image doesn't reach the lower value
-      // boundary. Simply copy the source to the destination.
-      source_roi.copyTo(destination_roi);
+GradientFilter::Cost GradientFilter::Measure(
+    const std::vector<Block>& blocks) const {
+  Cost cost = Cost();
+  cost.blocks = blocks.size();
+  for (const auto& block : blocks) {
+    const cv::Rect& rect = block.rect;
+    const auto count = [&](Index filter_index) {
+      const cv::Size& ksize = filters_.at(filter_index)->ksize;
+      ++cost.invocations;
+      cost.halo_pixels += (rect.width + ksize.width - 1) *
+                          (rect.height + ksize.height - 1) - rect.area();
+    };
+    if (block.upper_index < 0) {
+      continue;
+    }
+    if (block.lower_index >= 0) {
+      count(block.lower_index);
+    }
+    if (block.upper_index - block.lower_index > 2) {
+      count(block.upper_index);
+    } else {
+      for (Index index = block.lower_index + 1;
+           index <= block.upper_index; ++index) {
+        count(index);
+      }
+    }
+  }
+  return cost;
+}
+
+void GradientFilter::ApplyInRect(const Block& block, double interval,
+                                 const cv::Mat3f& source,
+                                 const cv::Point& source_origin,
+                                 const cv::Point& destination_origin,
+                                 cv::Mat3f *destination) const {
+  // The gradient covers the whole image, whereas the source and the
+  // destination may cover regions of it.
+  const cv::Rect& rect = block.rect;
+  const cv::Rect source_rect = rect - source_origin;
+  const cv::Mat3f source_roi(source, source_rect);
+  cv::Mat3f destination_roi(*destination, rect - destination_origin);
+  const Index lower_index = block.lower_index;
+  const Index upper_index = block.upper_index;
 
-    } else if (lower_index == upper_index) {
-      // The minimum value of the gradient image exceeds the upper value
-      // boundary. Filter with the largest kernel since no need to composite.
-      Apply(source_roi, lower_index, &destination_roi);
+  if (upper_index < 0) {
+    // The maximum value of the gradient image doesn't reach the lower value
+    // boundary. Simply copy the source to the destination.
+    source_roi.copyTo(destination_roi);
 
+  } else if (lower_index == upper_index) {
+    // The minimum value of the gradient image exceeds the upper value
+    // boundary. Filter with the largest kernel since no need to composite.
+    Apply(source, source_rect, lower_index, &destination_roi);
+
+  } else {
+    // Values of the gradient span more than one boundary.
+    if (lower_index < 0) {
+      source_roi.copyTo(destination_roi);
     } else {
-      // Values of the gradient span more than one boundary.
-      if (lower_index < 0) {
-        source_roi.copyTo(destination_roi);
-      } else {
-        Apply(source_roi, lower_index, &destination_roi);
-      }
-      // Nodes that span more than two boundaries are exceptional cases, where
-      // the gradient might be too complex to subdivide. Complex gradients
-      // however could be approximated by just compositing lower and upper
-      // filter results, ignoring intermediating filters.
-      if (upper_index - lower_index > 2) {
-        const double lower_value = (lower_index + 1) * interval;
-        const double upper_value = (upper_index + 1) * interval;
-        ApplyComposite(source_roi, upper_index, destination_roi, gradient_roi,
-                       lower_value, upper_value, &destination_roi);
-      } else {
-        for (Index index = lower_index + 1; index <= upper_index; ++index) {
-          const double lower_value = index * interval;
-          const double upper_value = (index + 1) * interval;
-          ApplyComposite(source_roi, index, destination_roi, gradient_roi,
-                         lower_value, upper_value, &destination_roi);
-        }
+      Apply(source, source_rect, lower_index, &destination_roi);
+    }
+    // Nodes that span more than two boundaries are exceptional cases, where
+    // the gradient might be too complex to subdivide. Complex gradients
+    // however could be approximated by just compositing lower and upper
+    // filter results, ignoring intermediating filters.
+    if (upper_index - lower_index > 2) {
+      const double lower_value = (lower_index + 1) * interval;
+      const double upper_value = (upper_index + 1) * interval;
+      ApplyComposite(source, source_rect, upper_index, destination_roi,
+                     rect, lower_value, upper_value, &destination_roi);
+    } else {
+      for (Index index = lower_index + 1; index <= upper_index; ++index) {
+        const double lower_value = index * interval;
+        const double upper_value = (index + 1) * interval;
+        ApplyComposite(source, source_rect, index, destination_roi,
+                       rect, lower_value, upper_value, &destination_roi);
       }
     }
   }
 }
 
 void GradientFilter::ApplyComposite(const cv::Mat3f& source,
+                                    const cv::Rect& rect,
                                     Index filter_index,
                                     const cv::Mat3f& underlay,
-                                    const cv::Mat1f& gradient,
+                                    const cv::Rect& gradient_rect,
                                     double lower_value,
                                     double upper_value,
                                     cv::Mat3f *destination) const {
-  // Map values of the gradient between the lower and upper value boundaries
-  // within 0.0 - 1.0.
-  cv::Mat1f alpha_channel;
-  cv::subtract(gradient, lower_value, alpha_channel);
-  cv::divide(alpha_channel, upper_value - lower_value, alpha_channel);
-  cv::max(alpha_channel, 0.0, alpha_channel);
-  cv::min(alpha_channel, 1.0, alpha_channel);
-  cv::Mat3f alpha;
-  cv::merge(std::vector<cv::Mat1f>(source.channels(), alpha_channel), alpha);
+  assert(destination);
+  assert(underlay.size() == rect.size());
+  assert(gradient_rect.size() == rect.size());
+  assert(destination->size() == rect.size());
 
   // Filter overlay image with kernels for the given index.
-  cv::Mat3f overlay(source.size(), source.type());
-  Apply(source, filter_index, &overlay);
+  const Workspace::Buffer buffer(
+      workspace_->Acquire(rect.size(), source.type()));
+  cv::Mat3f overlay(buffer.mat());
+  Apply(source, rect, filter_index, &overlay);
 
-  // Perform standard alpha composition.
-  cv::multiply(overlay, alpha, overlay);
-  cv::multiply(underlay, cv::Scalar(1.0, 1.0, 1.0) - alpha, *destination);
-  cv::add(overlay, *destination, *destination);
+  // Gradients of lower resolution are interpolated row by row.
+  Workspace::Buffer values_buffer;
+  cv::Mat1f values;
+  if (gradient_scale_ != 1) {
+    values_buffer = workspace_->Acquire(cv::Size(rect.width, 1),
+                                        cv::DataType<float>::type);
+    values = values_buffer.mat();
+  }
+
+  // Map values of the gradient between the lower and upper value boundaries
+  // within 0.0 - 1.0, and perform standard alpha composition in one pass.
+  // The underlay may be the destination itself.
+  const float lower = lower_value;
+  const float scale = 1.0 / (upper_value - lower_value);
+  for (int y = 0; y < rect.height; ++y) {
+    const float *gradient_row;
+    if (gradient_scale_ == 1) {
+      gradient_row = gradient_[gradient_rect.y + y] + gradient_rect.x;
+    } else {
+      SampleGradient(gradient_rect, gradient_rect.y + y, values[0]);
+      gradient_row = values[0];
+    }
+    const cv::Vec3f *overlay_row = overlay[y];
+    const cv::Vec3f *underlay_row = underlay[y];
+    cv::Vec3f *destination_row = (*destination)[y];
+    for (int x = 0; x < rect.width; ++x) {
+      const float alpha = std::min(std::max(
+          (gradient_row[x] - lower) * scale, 0.0f), 1.0f);
+      const cv::Vec3f& over = overlay_row[x];
+      const cv::Vec3f& under = underlay_row[x];
+      destination_row[x] = cv::Vec3f(
+          under[0] + (over[0] - under[0]) * alpha,
+          under[1] + (over[1] - under[1]) * alpha,
+          under[2] + (over[2] - under[2]) * alpha);
+    }
+  }
 }
 
-void GradientFilter::Apply(const cv::Mat3f& source, Index filter_index,
-                           cv::Mat3f *destination) const {
+void GradientFilter::Apply(const cv::Mat3f& source, const cv::Rect& rect,
+                           Index filter_index, cv::Mat3f *destination) const {
+  assert(destination);
+  assert(destination->size() == rect.size());
   cv::Ptr<cv::FilterEngine> filter(filters_.at(filter_index));
-  filter->apply(source, *destination);
+  if (blur_stack_) {
+    // Filter the whole source once, and crop the rectangle of the retained
+    // level on subsequent calls.
+    if (!blur_stack_->Fetch(filter_index, rect, destination)) {
+      cv::Mat3f level(source.size());
+      filter->apply(source, level);
+      blur_stack_->Store(filter_index, level);
+      blur_stack_->Fetch(filter_index, rect, destination);
+    }
+  } else {
+    // Pixels outside the rectangle are read from the source as the border.
+    filter->apply(source, *destination, rect);
+  }
 }
 
 }  // namespace sgss
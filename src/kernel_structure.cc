@@ -0,0 +1,114 @@
+//
+//  sgss/kernel_structure.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include "sgss/kernel_structure.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+
+namespace sgss {
+
+KernelStructure::KernelStructure(const cv::Mat1f& kernel, double tolerance)
+    : size_(kernel.size()),
+      horizontally_symmetric_(true),
+      vertically_symmetric_(true),
+      separable_(false),
+      run_count_(),
+      nonzero_count_() {
+  assert(!kernel.empty());
+  double min_value;
+  double max_value;
+  cv::minMaxIdx(kernel, &min_value, &max_value);
+  const double epsilon = std::max(std::abs(min_value), std::abs(max_value)) *
+                         tolerance;
+
+  // Symmetry
+  for (int y = 0; y < kernel.rows; ++y) {
+    for (int x = 0; x < kernel.cols; ++x) {
+      const float value = kernel(y, x);
+      if (std::abs(value - kernel(y, kernel.cols - 1 - x)) > epsilon) {
+        horizontally_symmetric_ = false;
+      }
+      if (std::abs(value - kernel(kernel.rows - 1 - y, x)) > epsilon) {
+        vertically_symmetric_ = false;
+      }
+    }
+  }
+
+  // Separability is given by the rank of the kernel, that is the number of
+  // singular values that are not negligible.
+  cv::Mat1d inter_kernel;
+  kernel.convertTo(inter_kernel, cv::DataType<double>::type);
+  cv::Mat1d w;
+  cv::Mat1d u;
+  cv::Mat1d vt;
+  cv::SVDecomp(inter_kernel, w, u, vt);
+  if (w(0, 0) > 0.0 && (w.rows < 2 || w(1, 0) <= w(0, 0) * tolerance)) {
+    const double scale = std::sqrt(w(0, 0));
+    cv::Mat1d row_kernel = vt.row(0) * scale;
+    cv::Mat1d column_kernel = u.col(0) * scale;
+    if (cv::sum(row_kernel)[0] < 0.0) {
+      row_kernel *= -1.0;
+      column_kernel *= -1.0;
+    }
+    row_kernel.convertTo(row_kernel_, cv::DataType<float>::type);
+    column_kernel.convertTo(column_kernel_, cv::DataType<float>::type);
+    separable_ = true;
+  }
+
+  // Runs of taps whose weights are equal within the tolerance, skipping
+  // zero taps.
+  runs_.resize(kernel.rows);
+  for (int y = 0; y < kernel.rows; ++y) {
+    Row& row = runs_[y];
+    int x = 0;
+    while (x < kernel.cols) {
+      const float weight = kernel(y, x);
+      if (std::abs(weight) <= epsilon) {
+        ++x;
+        continue;
+      }
+      double sum = 0.0;
+      Run run = { x, 0, 0.0f };
+      while (x < kernel.cols && std::abs(kernel(y, x)) > epsilon &&
+             std::abs(kernel(y, x) - weight) <= epsilon) {
+        sum += kernel(y, x);
+        ++run.length;
+        ++x;
+      }
+      run.weight = sum / run.length;
+      row.push_back(run);
+      nonzero_count_ += run.length;
+    }
+    run_count_ += row.size();
+  }
+}
+
+}  // namespace sgss
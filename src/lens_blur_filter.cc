@@ -29,31 +29,162 @@
 #include <opencv2/opencv.hpp>
 
 #include <cassert>
+#include <cstddef>
+#include <vector>
 
+#include "sgss/blur_stack.h"
 #include "sgss/color.h"
+#include "sgss/workspace.h"
 
 namespace sgss {
 
 void LensBlurFilter::operator()(const cv::Mat& source, cv::Mat *destination) {
+  (*this)(source, cv::Rect(cv::Point(), source.size()), destination);
+}
+
+void LensBlurFilter::operator()(const cv::Mat& source,
+                                const cv::Rect& roi,
+                                cv::Mat *destination) {
   assert(!source.empty());
   assert(source.channels() == 3);
+  assert((roi & cv::Rect(cv::Point(), source.size())) == roi);
+  if (!interactive() &&
+      tile_size_.area() > 0 &&
+      (roi.width > tile_size_.width || roi.height > tile_size_.height) &&
+      destination->datastart != source.datastart) {
+    // Tiles can't be written in place, because halos of later tiles read
+    // the source around the earlier ones.
+    RenderTiles(&source, 1, roi, tile_size_, destination);
+    return;
+  }
+  const cv::Rect region = SourceRegion(source.size(), roi);
 
-  // Make intermediate exponential image
+  // Make intermediate exponential image only in the region needed. In
+  // interactive mode, the one made for the same source and brightness is
+  // reused, so that the blurred levels retained for it remain valid.
+  // Otherwise intermediate images are leased from the workspace.
+  const int type = cv::DataType<cv::Vec3f>::type;
+  Workspace::Buffer source_buffer;
   cv::Mat3f source_exp;
-  source.convertTo(source_exp, cv::DataDepth<float>::value);
+  if (interactive() &&
+      SharesData(source, source_key_) &&
+      brightness_ == source_exp_brightness_) {
+    source_exp = source_exp_;
+  } else {
+    if (!interactive()) {
+      source_buffer = workspace()->Acquire(region.size(), type);
+      source_exp = source_buffer.mat();
+    }
+    Exponentiate(cv::Mat(source, region), &source_exp);
+    if (interactive()) {
+      source_key_ = source;
+      source_exp_ = source_exp;
+      source_exp_brightness_ = brightness_;
+    }
+  }
+  const Workspace::Buffer destination_buffer(
+      workspace()->Acquire(roi.size(), type));
+  cv::Mat3f destination_exp(destination_buffer.mat());
+  Render(source_exp, region, roi, &destination_exp);
+  Logarithm(&destination_exp, source.depth(), destination);
+}
+
+void LensBlurFilter::operator()(const std::vector<cv::Mat>& sources,
+                                std::vector<cv::Mat> *destinations) {
+  assert(destinations);
+  const std::size_t count = sources.size();
+  destinations->resize(count);
+  if (interactive()) {
+    // Retained levels are made from one source at a time.
+    for (std::size_t i = 0; i < count; ++i) {
+      (*this)(sources[i], &(*destinations)[i]);
+    }
+    return;
+  }
+  if (sources.empty()) {
+    return;
+  }
+  const cv::Rect roi(cv::Point(), sources.front().size());
+  bool in_place = false;
+  for (std::size_t i = 0; i < count; ++i) {
+    assert(sources[i].size() == roi.size());
+    assert(sources[i].channels() == 3);
+    for (const auto& destination : *destinations) {
+      in_place = in_place || destination.datastart == sources[i].datastart;
+    }
+  }
+  // The whole batch is filtered as a single tile when it can't be tiled.
+  const bool tiled =
+      !in_place &&
+      tile_size_.area() > 0 &&
+      (roi.width > tile_size_.width || roi.height > tile_size_.height);
+  RenderTiles(sources.data(), count, roi, tiled ? tile_size_ : roi.size(),
+              destinations->data());
+}
+
+void LensBlurFilter::RenderTiles(const cv::Mat *sources,
+                                 std::size_t count,
+                                 const cv::Rect& roi,
+                                 const cv::Size& tile_size,
+                                 cv::Mat *destinations) {
+  assert(sources);
+  assert(destinations);
+  for (std::size_t i = 0; i < count; ++i) {
+    destinations[i].create(roi.size(), sources[i].type());
+  }
+  const cv::Size source_size = sources[0].size();
+  const int type = cv::DataType<cv::Vec3f>::type;
+  std::vector<Workspace::Buffer> buffers;
+  buffers.reserve(count * 2);
+  std::vector<cv::Mat3f> sources_exp(count);
+  std::vector<cv::Mat3f> destinations_exp(count);
+  for (int y = roi.y; y < roi.y + roi.height; y += tile_size.height) {
+    for (int x = roi.x; x < roi.x + roi.width; x += tile_size.width) {
+      // The halo of every tile is only as large as the largest kernel the
+      // gradient needs in it. Buffers of the same size classes are leased
+      // again for every tile, and remain in cache.
+      const cv::Rect tile = roi & cv::Rect(cv::Point(x, y), tile_size);
+      const cv::Rect region = SourceRegion(source_size, tile);
+      buffers.clear();
+      for (std::size_t i = 0; i < count; ++i) {
+        buffers.push_back(workspace()->Acquire(region.size(), type));
+        sources_exp[i] = buffers.back().mat();
+        Exponentiate(cv::Mat(sources[i], region), &sources_exp[i]);
+        buffers.push_back(workspace()->Acquire(tile.size(), type));
+        destinations_exp[i] = buffers.back().mat();
+      }
+      Render(sources_exp.data(), count, region, tile,
+             destinations_exp.data());
+      for (std::size_t i = 0; i < count; ++i) {
+        cv::Mat destination_tile(destinations[i], tile - roi.tl());
+        Logarithm(&destinations_exp[i], sources[i].depth(),
+                  &destination_tile);
+      }
+    }
+  }
+}
+
+void LensBlurFilter::Exponentiate(const cv::Mat& source,
+                                  cv::Mat3f *destination) const {
+  assert(destination);
+  source.convertTo(*destination, cv::DataDepth<float>::value);
   if (brightness_ > 0.0) {
-    source_exp *= brightness_ / color::constants::max(source.depth());
-    cv::exp(source_exp, source_exp);
+    *destination *= brightness_ / color::constants::max(source.depth());
+    cv::exp(*destination, *destination);
   }
-  cv::Mat3f destination_exp(source.size());
-  GradientFilter::operator()(source_exp, &destination_exp);
+}
 
+void LensBlurFilter::Logarithm(cv::Mat3f *source,
+                               int depth,
+                               cv::Mat *destination) const {
+  assert(source);
+  assert(destination);
   // Log the exponential image back to linear
   if (brightness_ > 0.0) {
-    cv::log(destination_exp, destination_exp);
-    destination_exp *= color::constants::max(source.depth()) / brightness_;
+    cv::log(*source, *source);
+    *source *= color::constants::max(depth) / brightness_;
   }
-  destination_exp.convertTo(*destination, source.depth());
+  source->convertTo(*destination, depth);
 }
 
 }  // namespace sgss
@@ -37,10 +37,22 @@ namespace sgss {
 
 void Quadtree::Insert(const cv::Mat& matrix, double interval,
                       const cv::Size& size_limit, std::size_t max_span) {
-  assert(matrix.channels() == 1);
+  Insert(matrix, matrix, interval, size_limit, max_span);
+}
+
+void Quadtree::Insert(const cv::Mat& min_matrix, const cv::Mat& max_matrix,
+                      double interval, const cv::Size& size_limit,
+                      std::size_t max_span) {
+  assert(min_matrix.channels() == 1 && max_matrix.channels() == 1);
+  assert(min_matrix.size() == max_matrix.size());
   assert(interval > 0.0);
   assert(max_span > 0);
-  cv::minMaxIdx(cv::Mat(matrix, rect_), &min_value_, &max_value_);
+  if (min_matrix.data == max_matrix.data) {
+    cv::minMaxIdx(cv::Mat(min_matrix, rect_), &min_value_, &max_value_);
+  } else {
+    cv::minMaxIdx(cv::Mat(min_matrix, rect_), &min_value_, nullptr);
+    cv::minMaxIdx(cv::Mat(max_matrix, rect_), nullptr, &max_value_);
+  }
 
   // Subdivide this node when values in the region of interest of the matrix
   // span more than the number of value boundaries defined by max_span.
@@ -49,7 +61,7 @@ void Quadtree::Insert(const cv::Mat& matrix, double interval,
       max_value_ > (std::floor(min_value_ / interval) + max_span) * interval) {
     Subdivide();
     for (auto& node : nodes_) {
-      node->Insert(matrix, interval, size_limit, max_span);
+      node->Insert(min_matrix, max_matrix, interval, size_limit, max_span);
     }
   }
 }
@@ -65,10 +77,20 @@ void Quadtree::Subdivide() {
     const Value y2 = y1 + h1;
     const Value w2 = rect_.width - w1;
     const Value h2 = rect_.height - h1;
-    nodes_.emplace_back(new Quadtree(level_ + 1, cv::Rect(x1, y1, w1, h1)));
-    nodes_.emplace_back(new Quadtree(level_ + 1, cv::Rect(x2, y1, w2, h1)));
-    nodes_.emplace_back(new Quadtree(level_ + 1, cv::Rect(x1, y2, w1, h2)));
-    nodes_.emplace_back(new Quadtree(level_ + 1, cv::Rect(x2, y2, w2, h2)));
+    const cv::Rect rects[] = {
+      cv::Rect(x1, y1, w1, h1),
+      cv::Rect(x2, y1, w2, h1),
+      cv::Rect(x1, y2, w1, h2),
+      cv::Rect(x2, y2, w2, h2),
+    };
+    // Reuse quadrant nodes left by the last reset if any.
+    for (std::size_t i = 0; i < 4; ++i) {
+      if (i < nodes_.size()) {
+        nodes_[i]->Reset(level_ + 1, rects[i]);
+      } else {
+        nodes_.emplace_back(new Quadtree(level_ + 1, rects[i]));
+      }
+    }
     empty_ = false;
   }
 }
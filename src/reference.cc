@@ -0,0 +1,180 @@
+//
+//  sgss/reference.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include "sgss/reference.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include "sgss/color.h"
+#include "sgss/gradient_filter.h"
+#include "sgss/lens_blur_filter.h"
+
+namespace sgss {
+namespace reference {
+
+namespace {
+
+using Index = GradientFilter::Index;
+
+// Correlates the kernel with the source around the given pixel, in the same
+// manner as linear filter engines do, reflecting the source at its borders
+cv::Vec3d Convolve(const cv::Mat3d& source,
+                   const cv::Mat1f& kernel,
+                   int x,
+                   int y) {
+  const int anchor_x = kernel.cols / 2;
+  const int anchor_y = kernel.rows / 2;
+  cv::Vec3d result;
+  for (int j = 0; j < kernel.rows; ++j) {
+    const int source_y = cv::borderInterpolate(
+        y + j - anchor_y, source.rows, cv::BORDER_REFLECT_101);
+    for (int i = 0; i < kernel.cols; ++i) {
+      const int source_x = cv::borderInterpolate(
+          x + i - anchor_x, source.cols, cv::BORDER_REFLECT_101);
+      const cv::Vec3d& value = source(source_y, source_x);
+      const double weight = kernel(j, i);
+      for (int channel = 0; channel < 3; ++channel) {
+        result[channel] += value[channel] * weight;
+      }
+    }
+  }
+  return result;
+}
+
+// Filters the source in double precision
+void RenderExact(const GradientFilter& filter,
+                 const cv::Mat3d& source,
+                 cv::Mat3d *destination) {
+  assert(destination);
+  const std::vector<cv::Mat1f>& kernels = filter.kernels();
+  const Index count = kernels.size();
+  destination->create(source.size());
+  if (filter.gradient().empty()) {
+    for (int y = 0; y < source.rows; ++y) {
+      for (int x = 0; x < source.cols; ++x) {
+        (*destination)(y, x) = Convolve(source, kernels.back(), x, y);
+      }
+    }
+    return;
+  }
+  const double size = filter.range().second - filter.range().first;
+  assert(size);
+  const double interval = size / (count + 1);
+  for (int y = 0; y < source.rows; ++y) {
+    for (int x = 0; x < source.cols; ++x) {
+      // Boundaries the value of this pixel lies between, computed in the same
+      // manner as for the nodes of the quadtree.
+      const double value = filter.SampleGradient(cv::Point(x, y));
+      const Index lower_index = std::min<Index>(
+          std::floor(value / interval), count) - 1;
+      const Index upper_index = std::min<Index>(
+          std::ceil(value / interval), count) - 1;
+      cv::Vec3d result;
+      if (lower_index < 0) {
+        result = source(y, x);
+      } else {
+        result = Convolve(source, kernels[lower_index], x, y);
+      }
+      if (upper_index > lower_index) {
+        const double lower_value = upper_index * interval;
+        const double alpha = std::max(0.0, std::min(1.0,
+            (value - lower_value) / interval));
+        const cv::Vec3d overlay = Convolve(source, kernels[upper_index], x, y);
+        for (int channel = 0; channel < 3; ++channel) {
+          result[channel] = overlay[channel] * alpha +
+                            result[channel] * (1.0 - alpha);
+        }
+      }
+      (*destination)(y, x) = result;
+    }
+  }
+}
+
+}  // namespace
+
+void Render(const GradientFilter& filter,
+            const cv::Mat& source,
+            cv::Mat *destination) {
+  assert(!source.empty());
+  assert(source.channels() == 3);
+  assert(destination);
+  cv::Mat3d inter_source;
+  source.convertTo(inter_source, cv::DataType<cv::Vec3d>::type);
+  cv::Mat3d inter_destination;
+  RenderExact(filter, inter_source, &inter_destination);
+  inter_destination.convertTo(*destination, source.type());
+}
+
+void Render(const LensBlurFilter& filter,
+            const cv::Mat& source,
+            cv::Mat *destination) {
+  assert(!source.empty());
+  assert(source.channels() == 3);
+  assert(destination);
+  const double brightness = filter.brightness();
+  const double max = color::constants::max(source.depth());
+  cv::Mat3d source_exp;
+  source.convertTo(source_exp, cv::DataType<cv::Vec3d>::type);
+  if (brightness > 0.0) {
+    source_exp *= brightness / max;
+    cv::exp(source_exp, source_exp);
+  }
+  cv::Mat3d destination_exp;
+  RenderExact(filter, source_exp, &destination_exp);
+  if (brightness > 0.0) {
+    cv::log(destination_exp, destination_exp);
+    destination_exp *= max / brightness;
+  }
+  destination_exp.convertTo(*destination, source.depth());
+}
+
+Difference Compare(const cv::Mat& a, const cv::Mat& b) {
+  assert(a.size() == b.size());
+  assert(a.channels() == b.channels());
+  cv::Mat inter_a;
+  cv::Mat inter_b;
+  a.convertTo(inter_a, CV_MAKETYPE(cv::DataDepth<double>::value,
+                                   a.channels()));
+  b.convertTo(inter_b, CV_MAKETYPE(cv::DataDepth<double>::value,
+                                   b.channels()));
+  cv::Mat difference;
+  cv::absdiff(inter_a, inter_b, difference);
+  difference = difference.reshape(1);
+  Difference result = Difference();
+  cv::minMaxIdx(difference, nullptr, &result.max);
+  result.mean = cv::mean(difference)[0];
+  const double norm = cv::norm(difference, cv::NORM_L2);
+  result.rms = norm / std::sqrt(static_cast<double>(difference.total()));
+  return result;
+}
+
+}  // namespace reference
+}  // namespace sgss
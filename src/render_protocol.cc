@@ -0,0 +1,146 @@
+//
+//  sgss/render_protocol.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include "sgss/render_protocol.h"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+
+namespace sgss {
+namespace render {
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+const int kSendFlags = MSG_NOSIGNAL;
+#else
+const int kSendFlags = 0;
+#endif
+
+}  // namespace
+
+bool Send(int socket,
+          const void *message,
+          std::size_t size,
+          const int *descriptors,
+          std::size_t descriptor_count) {
+  assert(message);
+  assert(descriptor_count <= kMaxDescriptors);
+  assert(!descriptor_count || descriptors);
+  const char *bytes = static_cast<const char *>(message);
+  std::size_t sent = 0;
+  while (sent < size) {
+    iovec vector = {const_cast<char *>(bytes + sent), size - sent};
+    msghdr header = {};
+    header.msg_iov = &vector;
+    header.msg_iovlen = 1;
+
+    // Descriptors are attached to the first byte only.
+    char control[CMSG_SPACE(sizeof(int) * kMaxDescriptors)] = {};
+    if (!sent && descriptor_count) {
+      header.msg_control = control;
+      header.msg_controllen = CMSG_SPACE(sizeof(int) * descriptor_count);
+      cmsghdr *control_header = CMSG_FIRSTHDR(&header);
+      control_header->cmsg_level = SOL_SOCKET;
+      control_header->cmsg_type = SCM_RIGHTS;
+      control_header->cmsg_len = CMSG_LEN(sizeof(int) * descriptor_count);
+      std::memcpy(CMSG_DATA(control_header), descriptors,
+                  sizeof(int) * descriptor_count);
+    }
+    const ssize_t result = sendmsg(socket, &header, kSendFlags);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    sent += result;
+  }
+  return true;
+}
+
+bool Receive(int socket,
+             void *message,
+             std::size_t size,
+             int *descriptors,
+             std::size_t *descriptor_count) {
+  assert(message);
+  assert(!descriptor_count || descriptors);
+  if (descriptor_count) {
+    *descriptor_count = 0;
+  }
+  char *bytes = static_cast<char *>(message);
+  std::size_t received = 0;
+  while (received < size) {
+    iovec vector = {bytes + received, size - received};
+    msghdr header = {};
+    header.msg_iov = &vector;
+    header.msg_iovlen = 1;
+    char control[CMSG_SPACE(sizeof(int) * kMaxDescriptors)] = {};
+    header.msg_control = control;
+    header.msg_controllen = sizeof(control);
+    const ssize_t result = recvmsg(socket, &header, 0);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    // Take ownership of descriptors received before failing, so that they
+    // are closed instead of leaking.
+    for (cmsghdr *control_header = CMSG_FIRSTHDR(&header); control_header;
+         control_header = CMSG_NXTHDR(&header, control_header)) {
+      if (control_header->cmsg_level != SOL_SOCKET ||
+          control_header->cmsg_type != SCM_RIGHTS) {
+        continue;
+      }
+      const std::size_t count =
+          (control_header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      const int *data = reinterpret_cast<const int *>(
+          CMSG_DATA(control_header));
+      for (std::size_t i = 0; i < count; ++i) {
+        if (descriptor_count && *descriptor_count < kMaxDescriptors) {
+          fcntl(data[i], F_SETFD, FD_CLOEXEC);
+          descriptors[(*descriptor_count)++] = data[i];
+        } else {
+          close(data[i]);
+        }
+      }
+    }
+    if (result <= 0) {
+      return false;
+    }
+    received += result;
+  }
+  return true;
+}
+
+}  // namespace render
+}  // namespace sgss
@@ -0,0 +1,486 @@
+//
+//  sgss/render_server.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include "sgss/render_server.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "sgss/lens_blur_filter.h"
+#include "sgss/render_protocol.h"
+
+namespace sgss {
+namespace render {
+
+namespace {
+
+// Number of recent latencies to take percentiles of
+const std::size_t kLatencyCount = 4096;
+
+// Time to wait for a client to take a response before dropping it
+const int kSendTimeoutSeconds = 1;
+
+// Shared memory of a frame mapped for the duration of a job
+class Mapping {
+ public:
+  // Constructors
+  Mapping() : data_(MAP_FAILED), size_() {}
+  Mapping(const Mapping& other) = delete;
+  ~Mapping() {
+    if (data_ != MAP_FAILED) {
+      munmap(data_, size_);
+    }
+  }
+
+  // Assignment
+  Mapping& operator=(const Mapping& other) = delete;
+
+  // Maps the descriptor as a matrix, and returns false if the size or type
+  // is invalid, or the memory is too small
+  bool Map(int descriptor, const cv::Size& size, int type, bool writable) {
+    assert(data_ == MAP_FAILED);
+    if (size.width <= 0 || size.height <= 0 ||
+        type != CV_MAT_TYPE(type) || CV_MAT_DEPTH(type) > CV_64F) {
+      return false;
+    }
+    // Sizes are from clients, and their product may not fit in int.
+    const std::uint64_t pixels = static_cast<std::uint64_t>(size.width) *
+                                 static_cast<std::uint64_t>(size.height);
+    const std::uint64_t element_size = CV_ELEM_SIZE(type);
+    struct stat status;
+    if (fstat(descriptor, &status) || status.st_size < 0 ||
+        static_cast<std::uint64_t>(status.st_size) / element_size < pixels) {
+      return false;
+    }
+    const std::uint64_t bytes = pixels * element_size;
+    if (bytes > std::numeric_limits<std::size_t>::max()) {
+      return false;
+    }
+    data_ = mmap(nullptr, bytes,
+                 writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                 MAP_SHARED, descriptor, 0);
+    if (data_ == MAP_FAILED) {
+      return false;
+    }
+    size_ = bytes;
+    mat_ = cv::Mat(size, type, data_);
+    return true;
+  }
+
+  // Matrix referring to the mapped memory
+  const cv::Mat& mat() const { return mat_; }
+
+ private:
+  // Data members
+  void *data_;
+  std::size_t size_;
+  cv::Mat mat_;
+};
+
+double Seconds(Server::Clock::duration duration) {
+  return std::chrono::duration<double>(duration).count();
+}
+
+void CloseDescriptors(const int *descriptors, std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    close(descriptors[i]);
+  }
+}
+
+// Whether the descriptors refer to the same file, which maps to different
+// addresses of the same memory
+bool SameFile(int descriptor, int other_descriptor) {
+  struct stat status;
+  struct stat other_status;
+  return !fstat(descriptor, &status) &&
+         !fstat(other_descriptor, &other_status) &&
+         status.st_dev == other_status.st_dev &&
+         status.st_ino == other_status.st_ino;
+}
+
+}  // namespace
+
+Server::Connection::~Connection() {
+  close(socket);
+}
+
+Server::Server(const std::string& path,
+               const std::vector<FilterFactory>& factories,
+               std::size_t worker_count,
+               std::size_t queue_limit)
+    : path_(path),
+      factories_(factories),
+      worker_count_(worker_count),
+      queue_limit_(queue_limit),
+      socket_(-1),
+      stopping_(false),
+      completed_(),
+      failed_(),
+      latency_index_() {
+  assert(!factories_.empty());
+  assert(worker_count_ > 0);
+}
+
+Server::~Server() {
+  Shutdown();
+}
+
+bool Server::Start() {
+  assert(socket_ < 0);
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (path_.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::strncpy(address.sun_path, path_.c_str(), sizeof(address.sun_path) - 1);
+  socket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (socket_ < 0) {
+    return false;
+  }
+  fcntl(socket_, F_SETFD, FD_CLOEXEC);
+  unlink(path_.c_str());  // Left by a daemon that didn't exit cleanly
+  if (bind(socket_, reinterpret_cast<const sockaddr *>(&address),
+           sizeof(address)) ||
+      listen(socket_, SOMAXCONN)) {
+    close(socket_);
+    socket_ = -1;
+    return false;
+  }
+  for (std::size_t index = 0; index < worker_count_; ++index) {
+    workers_.emplace_back(&Server::Work, this);
+  }
+  return true;
+}
+
+void Server::Run() {
+  assert(socket_ >= 0);
+  while (!stopping_) {
+    // Wake up periodically to notice requests to stop from signal handlers.
+    pollfd descriptor = {socket_, POLLIN, 0};
+    if (poll(&descriptor, 1, 100) > 0) {
+      const int client = accept(socket_, nullptr, nullptr);
+      if (client >= 0) {
+        fcntl(client, F_SETFD, FD_CLOEXEC);
+        timeval timeout = {};
+        timeout.tv_sec = kSendTimeoutSeconds;
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+        const int value = 1;
+        setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &value, sizeof(value));
+#endif
+        const auto connection = std::make_shared<Connection>(client);
+        clients_.emplace_back(
+            std::thread(&Server::Serve, this, connection), connection);
+      }
+    }
+    // Join the threads of clients that have disconnected.
+    for (auto it = clients_.begin(); it != clients_.end();) {
+      if (it->second->closed) {
+        it->first.join();
+        it = clients_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  Shutdown();
+}
+
+void Server::Stop() {
+  stopping_ = true;
+}
+
+void Server::Shutdown() {
+  stopping_ = true;
+  if (socket_ >= 0) {
+    close(socket_);
+    unlink(path_.c_str());
+    socket_ = -1;
+  }
+  for (auto& client : clients_) {
+    shutdown(client.second->socket, SHUT_RDWR);
+    client.first.join();
+  }
+  clients_.clear();
+  {
+    // Workers finish the jobs already queued before exiting.
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    queue_condition_.notify_all();
+  }
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+}
+
+Statistics Server::statistics() const {
+  Statistics statistics = Statistics();
+  statistics.magic = kMagic;
+  statistics.status = static_cast<std::uint32_t>(Status::kOK);
+  statistics.workers = worker_count_;
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    statistics.queue_depth = queue_.size();
+  }
+  std::vector<double> latencies;
+  {
+    std::lock_guard<std::mutex> lock(statistics_mutex_);
+    statistics.completed = completed_;
+    statistics.failed = failed_;
+    latencies = latencies_;
+  }
+  if (!latencies.empty()) {
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&](double rank) {
+      const std::size_t index = rank * latencies.size();
+      return latencies[std::min(index, latencies.size() - 1)];
+    };
+    statistics.latency_p50 = percentile(0.50);
+    statistics.latency_p90 = percentile(0.90);
+    statistics.latency_p99 = percentile(0.99);
+    statistics.latency_max = latencies.back();
+  }
+  return statistics;
+}
+
+void Server::Serve(std::shared_ptr<Connection> connection) {
+  while (!stopping_) {
+    Job job;
+    job.connection = connection;
+    if (!Receive(connection->socket, &job.request, sizeof(job.request),
+                 job.descriptors, &job.descriptor_count)) {
+      CloseDescriptors(job.descriptors, job.descriptor_count);
+      break;
+    }
+    job.received = Clock::now();
+    const Request& request = job.request;
+    if (request.magic != kMagic) {
+      // The stream can't be trusted anymore.
+      CloseDescriptors(job.descriptors, job.descriptor_count);
+      break;
+    }
+    Response response = Response();
+    response.magic = kMagic;
+    response.id = request.id;
+    switch (static_cast<MessageType>(request.type)) {
+      case MessageType::kRender: {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        if (queue_.size() < queue_limit_) {
+          queue_.push_back(job);
+          lock.unlock();
+          queue_condition_.notify_one();
+          continue;
+        }
+        lock.unlock();
+        CloseDescriptors(job.descriptors, job.descriptor_count);
+        RecordRejection();
+        response.status = static_cast<std::uint32_t>(Status::kBusy);
+        Respond(connection.get(), response);
+        break;
+      }
+      case MessageType::kStatistics: {
+        CloseDescriptors(job.descriptors, job.descriptor_count);
+        const Statistics statistics = this->statistics();
+        Reply(connection.get(), &statistics, sizeof(statistics));
+        break;
+      }
+      default:
+        CloseDescriptors(job.descriptors, job.descriptor_count);
+        response.status = static_cast<std::uint32_t>(Status::kInvalidRequest);
+        Respond(connection.get(), response);
+        break;
+    }
+  }
+  connection->closed = true;
+}
+
+void Server::Respond(Connection *connection, const Response& response) {
+  Reply(connection, &response, sizeof(response));
+}
+
+void Server::Reply(Connection *connection,
+                   const void *data,
+                   std::size_t size) {
+  assert(connection);
+  std::lock_guard<std::mutex> lock(connection->mutex);
+  if (connection->dropped) {
+    return;
+  }
+  if (!Send(connection->socket, data, size)) {
+    // A partial message corrupts the stream. Shutting the socket down makes
+    // the connection stop reading requests, and later responses are
+    // discarded.
+    connection->dropped = true;
+    shutdown(connection->socket, SHUT_RDWR);
+  }
+}
+
+void Server::Work() {
+  // Prepare filters before taking any job, so that the first request doesn't
+  // pay for building kernels.
+  std::vector<LensBlurFilter> filters;
+  for (const auto& factory : factories_) {
+    filters.push_back(factory());
+  }
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex_);
+      queue_condition_.wait(lock, [this]() {
+        return stopping_ || !queue_.empty();
+      });
+      if (queue_.empty()) {
+        break;
+      }
+      job = queue_.front();
+      queue_.pop_front();
+    }
+    const Clock::time_point start = Clock::now();
+    const Status status = Process(job, &filters);
+    CloseDescriptors(job.descriptors, job.descriptor_count);
+    const Clock::time_point end = Clock::now();
+    Response response = Response();
+    response.magic = kMagic;
+    response.status = static_cast<std::uint32_t>(status);
+    response.id = job.request.id;
+    response.queue_seconds = Seconds(start - job.received);
+    response.render_seconds = Seconds(end - start);
+    Respond(job.connection.get(), response);
+    Record(status == Status::kOK, Seconds(end - job.received));
+  }
+}
+
+Status Server::Process(const Job& job, std::vector<LensBlurFilter> *filters) {
+  assert(filters);
+  const Request& request = job.request;
+  if (request.filter < 0 ||
+      static_cast<std::size_t>(request.filter) >= filters->size() ||
+      request.width <= 0 || request.height <= 0 ||
+      CV_MAT_CN(request.frame_type) != 3) {
+    return Status::kInvalidRequest;
+  }
+  const int depth = CV_MAT_DEPTH(request.frame_type);
+  if (depth != CV_8U && depth != CV_16U && depth != CV_32F) {
+    return Status::kInvalidRequest;
+  }
+  const cv::Size size(request.width, request.height);
+  const bool has_gradient = request.gradient_width > 0;
+  const int scale = request.gradient_scale > 1 ? request.gradient_scale : 1;
+  const cv::Size gradient_size(request.gradient_width,
+                               request.gradient_height);
+  // Sizes are rounded up without adding the scale, which could overflow.
+  const int gradient_depth = CV_MAT_DEPTH(request.gradient_type);
+  if (has_gradient &&
+      (CV_MAT_CN(request.gradient_type) != 1 ||
+       gradient_depth < CV_8U || gradient_depth > CV_64F ||
+       gradient_size.width != (size.width - 1) / scale + 1 ||
+       gradient_size.height != (size.height - 1) / scale + 1)) {
+    return Status::kInvalidRequest;
+  }
+  if (job.descriptor_count < (has_gradient ? 3 : 2)) {
+    return Status::kInvalidFrame;
+  }
+  Mapping source;
+  Mapping destination;
+  Mapping gradient;
+  if (!source.Map(job.descriptors[0], size, request.frame_type, false) ||
+      !destination.Map(job.descriptors[1], size, request.frame_type, true) ||
+      (has_gradient && !gradient.Map(job.descriptors[2], gradient_size,
+                                     request.gradient_type, false))) {
+    return Status::kInvalidFrame;
+  }
+
+  // Filter directly into the mapped destination, which has the size and
+  // type the filter makes.
+  LensBlurFilter& filter = filters->at(request.filter);
+  filter.set_brightness(request.brightness);
+  filter.set_gradient(gradient.mat(), scale);
+  // The filter can't tell that the destination is mapped from the same file
+  // as the source or the gradient, and tiles would overwrite them while
+  // later tiles still read them. Filtering at once reads them all before
+  // writing the destination.
+  const cv::Size tile_size(filter.tile_size());
+  if (SameFile(job.descriptors[1], job.descriptors[0]) ||
+      (has_gradient && SameFile(job.descriptors[1], job.descriptors[2]))) {
+    filter.set_tile_size(cv::Size());
+  }
+  cv::Mat result(destination.mat());
+  filter(source.mat(), &result);
+  filter.set_tile_size(tile_size);
+  if (result.data != destination.mat().data) {
+    cv::Mat mapped(destination.mat());
+    result.copyTo(mapped);
+  }
+  // The filter must not refer to the mapped gradient after unmapping.
+  filter.set_gradient(cv::Mat());
+  return Status::kOK;
+}
+
+void Server::Record(bool succeeded, double latency) {
+  std::lock_guard<std::mutex> lock(statistics_mutex_);
+  if (succeeded) {
+    ++completed_;
+  } else {
+    ++failed_;
+  }
+  if (latencies_.size() < kLatencyCount) {
+    latencies_.push_back(latency);
+  } else {
+    latencies_[latency_index_] = latency;
+    latency_index_ = (latency_index_ + 1) % kLatencyCount;
+  }
+}
+
+void Server::RecordRejection() {
+  std::lock_guard<std::mutex> lock(statistics_mutex_);
+  ++failed_;
+}
+
+}  // namespace render
+}  // namespace sgss
@@ -0,0 +1,124 @@
+//
+//  sgss/run_length_filter.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include "sgss/run_length_filter.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "sgss/engine.h"
+#include "sgss/kernel_structure.h"
+
+namespace sgss {
+
+RunLengthFilter::RunLengthFilter(const KernelStructure& structure)
+    : runs_(structure.runs()),
+      row_(0) {
+  ksize = structure.size();
+  anchor = cv::Point(ksize.width / 2, ksize.height / 2);
+}
+
+void RunLengthFilter::reset() {
+  row_ = 0;
+  std::fill(prefix_rows_.begin(), prefix_rows_.end(), -1);
+}
+
+void RunLengthFilter::operator()(const uchar **source,
+                                 uchar *destination,
+                                 int destination_step,
+                                 int count,
+                                 int width,
+                                 int channels) {
+  const int rows = ksize.height;
+  const int elements = width * channels;
+  const int row_elements = (width + ksize.width - 1) * channels;
+  if (prefix_sums_.size() != static_cast<std::size_t>(rows) ||
+      prefix_sums_.front().size() !=
+          static_cast<std::size_t>(row_elements + channels)) {
+    prefix_sums_.assign(rows, std::vector<double>(row_elements + channels));
+    prefix_rows_.assign(rows, -1);
+    prefix_sources_.assign(rows, nullptr);
+  }
+  sums_.resize(elements);
+
+  // Prefix sums are taken for every channel separately, so that the sum of
+  // a run of pixels is the difference of two of them. The ring is indexed by
+  // absolute source rows since the last reset, and keeps the rows that the
+  // next call shares with this one.
+  const auto accumulate = [&](int index) {
+    const int row_index = row_ + index;
+    const int slot = row_index % rows;
+    if (prefix_rows_[slot] == row_index &&
+        prefix_sources_[slot] == source[index]) {
+      return;
+    }
+    prefix_rows_[slot] = row_index;
+    prefix_sources_[slot] = source[index];
+    const float *row = reinterpret_cast<const float *>(source[index]);
+    double *prefix_sums = prefix_sums_[slot].data();
+    std::fill(prefix_sums, prefix_sums + channels, 0.0);
+    for (int i = 0; i < row_elements; ++i) {
+      prefix_sums[i + channels] = prefix_sums[i] + row[i];
+    }
+  };
+  for (int y = 0; y < rows - 1; ++y) {
+    accumulate(y);
+  }
+  for (int index = 0; index < count; ++index) {
+    // Every output row needs prefix sums of just one more source row.
+    accumulate(index + rows - 1);
+    std::fill(sums_.begin(), sums_.end(), 0.0);
+    for (int y = 0; y < rows; ++y) {
+      const double *prefix_sums =
+          prefix_sums_[(row_ + index + y) % rows].data();
+      for (const auto& run : runs_[y]) {
+        const double *begin = prefix_sums + run.x * channels;
+        const double *end = begin + run.length * channels;
+        const double weight = run.weight;
+        for (int i = 0; i < elements; ++i) {
+          sums_[i] += weight * (end[i] - begin[i]);
+        }
+      }
+    }
+    float *result = reinterpret_cast<float *>(
+        destination + destination_step * index);
+    std::copy(sums_.begin(), sums_.end(), result);
+  }
+  row_ += count;
+}
+
+cv::Ptr<cv::FilterEngine> CreateRunLengthFilter(
+    const KernelStructure& structure,
+    int type) {
+  assert(CV_MAT_DEPTH(type) == cv::DataDepth<float>::value);
+  return CreateFilterEngine(
+      cv::Ptr<cv::BaseFilter>(new RunLengthFilter(structure)), type);
+}
+
+}  // namespace sgss
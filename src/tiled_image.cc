@@ -0,0 +1,291 @@
+//
+//  sgss/tiled_image.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include "sgss/tiled_image.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "sgss/half.h"
+
+namespace sgss {
+
+namespace {
+
+const char kMagic[8] = { 'S', 'G', 'S', 'S', 'T', 'I', 'L', 'E' };
+const std::uint32_t kVersion = 1;
+const std::uint32_t kHalfPrecision = 1 << 0;
+
+// Tiles start at a page boundary and every tile at a cache line boundary
+const std::size_t kDataOffset = 4096;
+const std::size_t kTileAlignment = 64;
+
+struct Header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t flags;
+  std::uint32_t width;
+  std::uint32_t height;
+  std::int32_t type;
+  std::uint32_t tile_width;
+  std::uint32_t tile_height;
+  std::uint32_t reserved;
+  std::uint64_t data_offset;
+};
+
+std::size_t TileBytes(const cv::Size& tile_size, int storage_type) {
+  const std::size_t bytes = static_cast<std::size_t>(tile_size.width) *
+                            tile_size.height * CV_ELEM_SIZE(storage_type);
+  return (bytes + kTileAlignment - 1) / kTileAlignment * kTileAlignment;
+}
+
+// Whether the header describes an image this implementation can map
+bool IsValid(const Header& header) {
+  const int max_size = std::numeric_limits<int>::max();
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion ||
+      (header.flags & ~kHalfPrecision) ||
+      !header.width || !header.height ||
+      !header.tile_width || !header.tile_height ||
+      header.width > max_size || header.height > max_size ||
+      header.tile_width > max_size || header.tile_height > max_size) {
+    return false;
+  }
+  // Only the depths up to double and up to 4 channels are known, and half
+  // precision is only for single precision images.
+  const int type = header.type;
+  const int depth = CV_MAT_DEPTH(type);
+  const int channels = CV_MAT_CN(type);
+  if (type < 0 || depth > CV_64F || channels < 1 || channels > 4 ||
+      type != CV_MAKETYPE(depth, channels)) {
+    return false;
+  }
+  const bool half_precision = header.flags & kHalfPrecision;
+  if (half_precision && depth != CV_32F) {
+    return false;
+  }
+  // Rows of tiles must be strided in int, and tiles with their alignment
+  // must be sized in size_t, so that tile bytes can't wrap to zero.
+  const std::uint64_t element_size = half_precision ?
+      sizeof(std::uint16_t) * channels : CV_ELEM_SIZE(type);
+  const std::uint64_t row_bytes = header.tile_width * element_size;
+  return row_bytes <= static_cast<std::uint64_t>(max_size) &&
+         header.tile_height <=
+             (std::numeric_limits<std::size_t>::max() - kTileAlignment) /
+             row_bytes;
+}
+
+}  // namespace
+
+bool TiledImage::Create(const std::string& path,
+                        const cv::Size& size,
+                        int type,
+                        const cv::Size& tile_size,
+                        bool half_precision) {
+  assert(size.width > 0 && size.height > 0);
+  assert(tile_size.width > 0 && tile_size.height > 0);
+  assert(!half_precision || CV_MAT_DEPTH(type) == CV_32F);
+  Close();
+  size_ = size;
+  type_ = type;
+  tile_size_ = tile_size;
+  half_precision_ = half_precision;
+  tile_bytes_ = TileBytes(tile_size_, storage_type());
+  data_offset_ = kDataOffset;
+  const cv::Size grid = grid_size();
+  const std::size_t length = data_offset_ +
+      static_cast<std::size_t>(grid.area()) * tile_bytes_;
+
+  const int descriptor = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (descriptor < 0) {
+    return false;
+  }
+  if (ftruncate(descriptor, length) != 0 ||
+      !Map(descriptor, length, true)) {
+    close(descriptor);
+    return false;
+  }
+  close(descriptor);
+
+  Header header = Header();
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.flags = half_precision_ ? kHalfPrecision : 0;
+  header.width = size_.width;
+  header.height = size_.height;
+  header.type = type_;
+  header.tile_width = tile_size_.width;
+  header.tile_height = tile_size_.height;
+  header.data_offset = data_offset_;
+  std::memcpy(data_, &header, sizeof(header));
+  return true;
+}
+
+bool TiledImage::Open(const std::string& path, bool writable) {
+  Close();
+  const int descriptor = open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+  if (descriptor < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(descriptor, &status) != 0 ||
+      static_cast<std::size_t>(status.st_size) < sizeof(Header) ||
+      !Map(descriptor, status.st_size, writable)) {
+    close(descriptor);
+    return false;
+  }
+  close(descriptor);
+
+  Header header;
+  std::memcpy(&header, data_, sizeof(header));
+  if (!IsValid(header) || header.data_offset > length_) {
+    Close();
+    return false;
+  }
+  size_ = cv::Size(header.width, header.height);
+  type_ = header.type;
+  tile_size_ = cv::Size(header.tile_width, header.tile_height);
+  half_precision_ = header.flags & kHalfPrecision;
+  tile_bytes_ = TileBytes(tile_size_, storage_type());
+  data_offset_ = header.data_offset;
+  // Compare the number of tiles with the number that fits in the rest of
+  // the file, so that a large grid can't overflow the product.
+  const cv::Size grid = grid_size();
+  const std::size_t tile_count = static_cast<std::size_t>(grid.width) *
+                                 grid.height;
+  if (tile_count > (length_ - data_offset_) / tile_bytes_) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void TiledImage::Close() {
+  if (data_) {
+    munmap(data_, length_);
+  }
+  data_ = nullptr;
+  length_ = 0;
+  writable_ = false;
+}
+
+bool TiledImage::Map(int descriptor, std::size_t length, bool writable) {
+  void *data = mmap(nullptr, length,
+                    writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                    MAP_SHARED, descriptor, 0);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  data_ = static_cast<std::uint8_t *>(data);
+  length_ = length;
+  writable_ = writable;
+  return true;
+}
+
+cv::Mat TiledImage::Tile(int column, int row) const {
+  assert(is_open());
+  const cv::Size grid = grid_size();
+  assert(column >= 0 && column < grid.width);
+  assert(row >= 0 && row < grid.height);
+  const cv::Rect rect = TileRect(column, row);
+  std::uint8_t *tile = data_ + data_offset_ +
+      (static_cast<std::size_t>(row) * grid.width + column) * tile_bytes_;
+  const int type = storage_type();
+  return cv::Mat(rect.size(), type, tile,
+                 static_cast<std::size_t>(tile_size_.width) *
+                     CV_ELEM_SIZE(type));
+}
+
+void TiledImage::Read(const cv::Rect& rect, cv::Mat *destination) const {
+  assert(is_open());
+  assert(destination);
+  assert((rect & cv::Rect(cv::Point(), size_)) == rect);
+  const int first_column = rect.x / tile_size_.width;
+  const int first_row = rect.y / tile_size_.height;
+  const int last_column = (rect.x + rect.width - 1) / tile_size_.width;
+  const int last_row = (rect.y + rect.height - 1) / tile_size_.height;
+  if (!half_precision_ &&
+      first_column == last_column && first_row == last_row) {
+    const cv::Rect tile_rect = TileRect(first_column, first_row);
+    *destination = Tile(first_column, first_row)(rect - tile_rect.tl());
+    return;
+  }
+  destination->create(rect.size(), type_);
+  for (int row = first_row; row <= last_row; ++row) {
+    for (int column = first_column; column <= last_column; ++column) {
+      const cv::Rect tile_rect = TileRect(column, row);
+      const cv::Rect intersection = tile_rect & rect;
+      const cv::Mat tile_roi(Tile(column, row), intersection - tile_rect.tl());
+      cv::Mat destination_roi(*destination, intersection - rect.tl());
+      if (half_precision_) {
+        half::Decode(tile_roi, &destination_roi);
+      } else {
+        tile_roi.copyTo(destination_roi);
+      }
+    }
+  }
+}
+
+void TiledImage::Write(const cv::Rect& rect, const cv::Mat& source) {
+  assert(is_open() && writable_);
+  assert(source.size() == rect.size());
+  assert(source.type() == type_);
+  assert((rect & cv::Rect(cv::Point(), size_)) == rect);
+  const int first_column = rect.x / tile_size_.width;
+  const int first_row = rect.y / tile_size_.height;
+  const int last_column = (rect.x + rect.width - 1) / tile_size_.width;
+  const int last_row = (rect.y + rect.height - 1) / tile_size_.height;
+  for (int row = first_row; row <= last_row; ++row) {
+    for (int column = first_column; column <= last_column; ++column) {
+      const cv::Rect tile_rect = TileRect(column, row);
+      const cv::Rect intersection = tile_rect & rect;
+      cv::Mat tile_roi(Tile(column, row), intersection - tile_rect.tl());
+      const cv::Mat source_roi(source, intersection - rect.tl());
+      if (source_roi.data == tile_roi.data) {
+        continue;  // Written in place through the mapped memory
+      }
+      if (half_precision_) {
+        half::Encode(source_roi, &tile_roi);
+      } else {
+        source_roi.copyTo(tile_roi);
+      }
+    }
+  }
+}
+
+}  // namespace sgss
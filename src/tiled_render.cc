@@ -0,0 +1,89 @@
+//
+//  sgss/tiled_render.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include "sgss/tiled_render.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cassert>
+
+#include "sgss/gradient_filter.h"
+#include "sgss/tiled_image.h"
+
+namespace sgss {
+
+void RenderTiled(GradientFilter *filter,
+                 const TiledImage& source,
+                 const TiledImage *gradient,
+                 TiledImage *destination) {
+  assert(filter);
+  assert(destination);
+  assert(source.is_open() && destination->is_open());
+  assert(source.size() == destination->size());
+  assert(source.type() == destination->type());
+  assert(!gradient || gradient->size() == source.size());
+  const cv::Rect bounds(cv::Point(), source.size());
+  const cv::Size halo(filter->kernel_size().width / 2,
+                      filter->kernel_size().height / 2);
+  const cv::Mat previous_gradient = filter->gradient();
+  const int previous_scale = filter->gradient_scale();
+  if (!gradient) {
+    // The gradient previously set covers the whole image instead of the
+    // regions of tiles.
+    filter->set_gradient(cv::Mat());
+  }
+
+  cv::Mat source_region;
+  cv::Mat gradient_region;
+  cv::Mat result;
+  cv::Mat tile;
+  const cv::Size grid = destination->grid_size();
+  for (int row = 0; row < grid.height; ++row) {
+    for (int column = 0; column < grid.width; ++column) {
+      const cv::Rect rect = destination->TileRect(column, row);
+      const cv::Rect region = bounds & cv::Rect(
+          rect.x - halo.width, rect.y - halo.height,
+          rect.width + halo.width * 2, rect.height + halo.height * 2);
+      source.Read(region, &source_region);
+      if (gradient) {
+        gradient->Read(region, &gradient_region);
+        filter->set_gradient(gradient_region);
+      }
+      // Filter only the rectangle of the tile, directly into the mapped
+      // memory unless it needs conversion to half precision.
+      if (destination->half_precision()) {
+        (*filter)(source_region, rect - region.tl(), &result);
+        destination->Write(rect, result);
+      } else {
+        tile = destination->Tile(column, row);
+        (*filter)(source_region, rect - region.tl(), &tile);
+      }
+    }
+  }
+  filter->set_gradient(previous_gradient, previous_scale);
+}
+
+}  // namespace sgss
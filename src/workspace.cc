@@ -0,0 +1,122 @@
+//
+//  sgss/workspace.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include "sgss/workspace.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace sgss {
+
+namespace {
+
+const std::size_t kMinimumCapacity = 4096;
+
+// Rounds the number of bytes up to its size class, which is a quarter step
+// between powers of two, wasting at most 25% of a block.
+std::size_t SizeClass(std::size_t bytes) {
+  if (bytes <= kMinimumCapacity) {
+    return kMinimumCapacity;
+  }
+  std::size_t power = kMinimumCapacity;
+  while (power * 2 < bytes) {
+    power *= 2;
+  }
+  const std::size_t step = power / 4;
+  return (bytes + step - 1) / step * step;
+}
+
+}  // namespace
+
+Workspace::Buffer Workspace::Acquire(const cv::Size& size, int type) {
+  const std::size_t bytes = static_cast<std::size_t>(size.area()) *
+                            CV_ELEM_SIZE(type);
+  const std::size_t capacity = SizeClass(bytes);
+  void *block = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<void *>& blocks = free_blocks_[capacity];
+    if (!blocks.empty()) {
+      block = blocks.back();
+      blocks.pop_back();
+    } else {
+      // Reserve room for returning this block later, so that returning
+      // never allocates.
+      blocks.reserve(blocks.capacity() + 1);
+      block = cv::fastMalloc(capacity);
+      capacity_ += capacity;
+      ++allocation_count_;
+    }
+    leased_ += capacity;
+    high_water_mark_ = std::max(high_water_mark_, leased_);
+  }
+  Buffer buffer;
+  buffer.workspace_ = this;
+  buffer.block_ = block;
+  buffer.capacity_ = capacity;
+  buffer.mat_ = cv::Mat(size, type, block);
+  return buffer;
+}
+
+void Workspace::Return(void *block, std::size_t capacity) {
+  assert(block);
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_blocks_[capacity].push_back(block);
+  leased_ -= capacity;
+}
+
+void Workspace::Trim() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& pair : free_blocks_) {
+    for (void *block : pair.second) {
+      cv::fastFree(block);
+      capacity_ -= pair.first;
+    }
+    pair.second.clear();
+  }
+}
+
+std::size_t Workspace::capacity() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return capacity_;
+}
+
+std::size_t Workspace::high_water_mark() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return high_water_mark_;
+}
+
+std::size_t Workspace::allocation_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return allocation_count_;
+}
+
+}  // namespace sgss
@@ -0,0 +1,461 @@
+//
+//  tests/reference.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "sgss/blur_stack.h"
+#include "sgss/engine.h"
+#include "sgss/kernel_structure.h"
+#include "sgss/lens_blur_filter.h"
+#include "sgss/reference.h"
+#include "sgss/tiled_image.h"
+#include "sgss/tiled_render.h"
+
+namespace {
+
+// Size of the images, which is small for the reference to finish quickly
+const cv::Size kImageSize(128, 96);
+
+// Size of the largest kernel
+const cv::Size kKernelSize(27, 27);
+
+// Brightness of specular highlight, to compare in the exponential domain
+const float kBrightness = 3.0;
+
+// Scale of the gradient of lower resolution
+const int kGradientScale = 2;
+
+// Size of tiles, which divides the images so that leaves of the quadtree of
+// every tile are no larger than those of the whole image
+const cv::Size kTileSize(32, 32);
+
+const sgss::Engine kEngines[] = {
+  sgss::Engine::kGeneric,
+  sgss::Engine::kSeparable,
+  sgss::Engine::kRunLength,
+  sgss::Engine::kFixedSize,
+};
+
+// Largest and root mean square differences from the reference allowed in
+// levels of 8-bit images
+struct Budget {
+  double max;
+  double rms;
+};
+
+// Modes of filtering
+enum class Mode {
+  kCoalesced,
+  kUncoalesced,
+  kROI,
+  kInteractive,
+  kInteractiveHalf,
+  kGradientScale,
+  kBatch,
+  kTiled,
+  kTiledBatch,
+  kTiledImage,
+};
+
+// Every mode with the budget of its differences. Simulating the filter in
+// single precision against double precision on these inputs differs by at
+// most 1 level and 0.005 in root mean square, where the exact value is near
+// half a level, and levels retained in half precision by 1 and 0.112.
+const struct {
+  Mode mode;
+  const char *name;
+  Budget budget;
+} kModes[] = {
+  { Mode::kCoalesced, "coalesced", { 1.0, 0.05 } },
+  { Mode::kUncoalesced, "uncoalesced", { 1.0, 0.05 } },
+  { Mode::kROI, "roi", { 1.0, 0.05 } },
+  { Mode::kInteractive, "interactive", { 1.0, 0.05 } },
+  { Mode::kInteractiveHalf, "interactive_half", { 1.0, 0.15 } },
+  { Mode::kGradientScale, "gradient_scale", { 1.0, 0.05 } },
+  { Mode::kBatch, "batch", { 1.0, 0.05 } },
+  { Mode::kTiled, "tiled", { 1.0, 0.05 } },
+  { Mode::kTiledBatch, "tiled_batch", { 1.0, 0.05 } },
+  { Mode::kTiledImage, "tiled_image", { 1.0, 0.05 } },
+};
+
+// Budget of every mode when the run-length engine approximates the kernels
+// of a diaphragm close to binary. The simulation differs by at most 3 levels
+// and 0.564 in root mean square, in single and half precision.
+const Budget kApproximateRunBudget = { 4.0, 0.75 };
+
+// Source images and the references of a filter with a gradient
+struct Expectation {
+  cv::Mat sources[2];
+  cv::Mat references[2];
+  cv::Mat scaled_reference;  // Of the first source and the scaled gradient
+};
+
+// Resizes the image read from the data directory to the size of images
+cv::Mat Read(const std::string& directory, const char *name, int flags) {
+  const cv::Mat image(cv::imread(directory + "/" + name, flags));
+  if (image.empty()) {
+    return image;
+  }
+  cv::Mat result;
+  cv::resize(image, result, kImageSize, 0.0, 0.0, cv::INTER_AREA);
+  return result;
+}
+
+// Crops the grayscale image read from the data directory to the size of
+// images at the origin, where its gradient is gentle
+cv::Mat Crop(const std::string& directory,
+             const char *name,
+             const cv::Point& origin) {
+  const cv::Mat image(cv::imread(directory + "/" + name,
+                                 cv::IMREAD_GRAYSCALE));
+  const cv::Rect rect(origin, kImageSize);
+  if ((rect & cv::Rect(cv::Point(), image.size())) != rect) {
+    return cv::Mat();
+  }
+  return image(rect).clone();
+}
+
+// Horizontal ramp of the slope in levels per pixel from the value
+cv::Mat Ramp(double value, double slope) {
+  cv::Mat1b ramp(kImageSize);
+  for (int y = 0; y < ramp.rows; ++y) {
+    for (int x = 0; x < ramp.cols; ++x) {
+      ramp(y, x) = cv::saturate_cast<uchar>(value + x * slope);
+    }
+  }
+  return ramp;
+}
+
+// Whether every pixel is composited exactly from two adjacent levels. Leaves
+// of the quadtree stop splitting at 8 pixels, and leaves that span more
+// levels are composited approximately, which the reference doesn't model.
+// A window of 12 pixels also holds the neighbours of the elements of a leaf
+// of the gradient at half resolution.
+bool IsExact(const sgss::GradientFilter& filter, const cv::Mat& gradient) {
+  const cv::Mat window(cv::Size(12, 12), CV_8U, cv::Scalar(1));
+  cv::Mat1b min;
+  cv::Mat1b max;
+  cv::erode(gradient, min, window);
+  cv::dilate(gradient, max, window);
+  const auto& range = filter.range();
+  const double interval =
+      (range.second - range.first) / (filter.kernels().size() + 1);
+  for (int y = 0; y < gradient.rows; ++y) {
+    for (int x = 0; x < gradient.cols; ++x) {
+      if (std::ceil(max(y, x) / interval) -
+          std::floor(min(y, x) / interval) > 2) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Profile that assigns the engine to every kernel of the filter
+sgss::EngineProfile ForceEngine(const sgss::GradientFilter& filter,
+                                sgss::Engine engine) {
+  sgss::EngineProfile profile;
+  for (const auto& kernel : filter.kernels()) {
+    profile.Insert(kernel, filter.run_tolerance(), engine);
+  }
+  return profile;
+}
+
+// Whether the engine applies to any kernel of the filter
+bool Applies(const sgss::GradientFilter& filter, sgss::Engine engine) {
+  const int type = cv::DataType<cv::Vec3f>::type;
+  for (const auto& kernel : filter.kernels()) {
+    const sgss::KernelStructure structure(kernel);
+    const sgss::KernelStructure run_structure(
+        sgss::RunStructure(kernel, structure, filter.run_tolerance()));
+    if (!sgss::CreateEngine(engine, kernel, structure, run_structure,
+                            type).empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Whether the run-length engine approximates weights of any kernel of the
+// filter, by merging weights that aren't equal into runs
+bool ApproximatesRuns(const sgss::GradientFilter& filter) {
+  const auto& kernels = filter.kernels();
+  for (std::size_t i = 0; i < kernels.size(); ++i) {
+    const sgss::KernelStructure structure(kernels[i]);
+    if (filter.engines()[i] == sgss::Engine::kRunLength &&
+        sgss::RunStructure(kernels[i], structure,
+                           filter.run_tolerance()).run_count() !=
+            structure.run_count()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Filters the source through tiled image files in the working directory
+bool RenderTiledImage(sgss::LensBlurFilter *filter,
+                      const cv::Mat& source,
+                      const cv::Mat& gradient,
+                      cv::Mat *destination) {
+  const cv::Rect bounds(cv::Point(), source.size());
+  const char *paths[] = {
+    "reference_source.tiled",
+    "reference_gradient.tiled",
+    "reference_destination.tiled",
+  };
+  bool succeeded = false;
+  {
+    sgss::TiledImage source_image;
+    sgss::TiledImage gradient_image;
+    sgss::TiledImage destination_image;
+    if (source_image.Create(paths[0], source.size(), source.type(),
+                            kTileSize) &&
+        gradient_image.Create(paths[1], gradient.size(), gradient.type(),
+                              kTileSize) &&
+        destination_image.Create(paths[2], source.size(), source.type(),
+                                 kTileSize)) {
+      source_image.Write(bounds, source);
+      gradient_image.Write(bounds, gradient);
+      sgss::RenderTiled(filter, source_image, &gradient_image,
+                        &destination_image);
+      destination_image.Read(bounds, destination);
+      *destination = destination->clone();
+      succeeded = true;
+    }
+  }
+  for (const auto path : paths) {
+    std::remove(path);
+  }
+  return succeeded;
+}
+
+// Filters the sources of the expectation with the filter in the mode, and
+// returns the results and the references they should match
+void Render(sgss::LensBlurFilter *filter,
+            Mode mode,
+            const cv::Mat& gradient,
+            const Expectation& expectation,
+            std::vector<cv::Mat> *results,
+            std::vector<cv::Mat> *references) {
+  const cv::Mat& source = expectation.sources[0];
+  const cv::Mat& reference = expectation.references[0];
+  const std::vector<cv::Mat> sources(expectation.sources,
+                                     expectation.sources + 2);
+  results->clear();
+  references->clear();
+  cv::Mat result;
+  switch (mode) {
+    case Mode::kCoalesced:
+    case Mode::kUncoalesced:
+      filter->set_coalesces_leaves(mode == Mode::kCoalesced);
+      (*filter)(source, &result);
+      filter->set_coalesces_leaves(true);
+      break;
+    case Mode::kROI: {
+      const cv::Rect roi(17, 11, 64, 48);
+      (*filter)(source, roi, &result);
+      results->push_back(result);
+      references->push_back(reference(roi));
+      return;
+    }
+    case Mode::kInteractive:
+    case Mode::kInteractiveHalf:
+      // The second filtering composites the retained levels.
+      filter->EnableInteractive(0, mode == Mode::kInteractive ?
+          sgss::BlurStack::Precision::kFull :
+          sgss::BlurStack::Precision::kHalf);
+      (*filter)(source, &result);
+      (*filter)(source, &result);
+      filter->DisableInteractive();
+      break;
+    case Mode::kGradientScale: {
+      cv::Mat scaled_gradient;
+      cv::resize(gradient, scaled_gradient,
+                 cv::Size((kImageSize.width - 1) / kGradientScale + 1,
+                          (kImageSize.height - 1) / kGradientScale + 1),
+                 0.0, 0.0, cv::INTER_AREA);
+      filter->set_gradient(scaled_gradient, kGradientScale);
+      (*filter)(source, &result);
+      filter->set_gradient(gradient);
+      results->push_back(result);
+      references->push_back(expectation.scaled_reference);
+      return;
+    }
+    case Mode::kBatch:
+    case Mode::kTiledBatch:
+      if (mode == Mode::kTiledBatch) {
+        filter->set_tile_size(kTileSize);
+      }
+      (*filter)(sources, results);
+      filter->set_tile_size(cv::Size());
+      references->assign(expectation.references,
+                         expectation.references + 2);
+      return;
+    case Mode::kTiled:
+      filter->set_tile_size(kTileSize);
+      (*filter)(source, &result);
+      filter->set_tile_size(cv::Size());
+      break;
+    case Mode::kTiledImage:
+      if (!RenderTiledImage(filter, source, gradient, &result)) {
+        return;
+      }
+      break;
+  }
+  results->push_back(result);
+  references->push_back(reference);
+}
+
+}  // namespace
+
+// Filters an image of the bundled data with gentle gradients with every
+// engine forced in turn, in every mode, and compares them with the per-pixel
+// reference within the budget of the mode. Takes the data directory.
+int main(int argc, char **argv) {
+  const std::string directory = argc > 1 ? argv[1] : "data";
+  const cv::Mat image(Read(directory, "image.jpg", cv::IMREAD_COLOR));
+  const cv::Mat diaphragm(cv::imread(directory + "/diaphragm.jpg",
+                                     cv::IMREAD_GRAYSCALE));
+  const cv::Mat linear(Crop(directory, "linear.jpg", cv::Point(880, 576)));
+  const cv::Mat radial(Crop(directory, "radial.jpg", cv::Point(960, 240)));
+  if (image.empty() || diaphragm.empty() || linear.empty() ||
+      radial.empty()) {
+    std::fprintf(stderr, "Failed to read data in %s\n", directory.c_str());
+    return EXIT_FAILURE;
+  }
+  cv::Mat flipped_image;
+  cv::flip(image, flipped_image, 1);
+
+  // A flat square is separable and made of long runs, so that every engine
+  // applies to it, and the diaphragm is neither.
+  const struct {
+    const char *name;
+    cv::Mat kernel;
+  } apertures[] = {
+    { "square", cv::Mat1f(kKernelSize, 1.0f) },
+    { "diaphragm", diaphragm },
+  };
+  const struct {
+    const char *name;
+    cv::Mat gradient;
+  } gradients[] = {
+    { "linear", linear },
+    { "radial", radial },
+    { "rising", Ramp(0.0, 1.2) },
+    { "falling", Ramp(255.0, -1.2) },
+  };
+
+  int failures = 0;
+  for (const auto& aperture : apertures) {
+    sgss::LensBlurFilter filter(aperture.kernel, kKernelSize);
+    filter.set_brightness(kBrightness);
+
+    // The reference doesn't depend on engines nor modes.
+    std::vector<Expectation> expectations;
+    for (const auto& gradient : gradients) {
+      if (!IsExact(filter, gradient.gradient)) {
+        std::printf("FAIL %-9s %-7s too steep\n", aperture.name,
+                    gradient.name);
+        return EXIT_FAILURE;
+      }
+      Expectation expectation;
+      expectation.sources[0] = image;
+      expectation.sources[1] = flipped_image;
+      filter.set_gradient(gradient.gradient);
+      for (int i = 0; i < 2; ++i) {
+        sgss::reference::Render(filter, expectation.sources[i],
+                                &expectation.references[i]);
+      }
+      cv::Mat scaled_gradient;
+      cv::resize(gradient.gradient, scaled_gradient,
+                 cv::Size((kImageSize.width - 1) / kGradientScale + 1,
+                          (kImageSize.height - 1) / kGradientScale + 1),
+                 0.0, 0.0, cv::INTER_AREA);
+      filter.set_gradient(scaled_gradient, kGradientScale);
+      sgss::reference::Render(filter, image, &expectation.scaled_reference);
+      expectations.push_back(expectation);
+    }
+
+    for (const auto engine : kEngines) {
+      if (!Applies(filter, engine)) {
+        std::printf("skip %-9s %-10s\n", aperture.name,
+                    sgss::EngineName(engine));
+        continue;
+      }
+      filter.set_engine_profile(ForceEngine(filter, engine));
+      const auto& engines = filter.engines();
+      if (std::find(engines.begin(), engines.end(), engine) ==
+          engines.end()) {
+        std::printf("FAIL %-9s %-10s not used\n", aperture.name,
+                    sgss::EngineName(engine));
+        ++failures;
+        continue;
+      }
+      const bool approximates_runs = ApproximatesRuns(filter);
+      for (std::size_t i = 0; i < expectations.size(); ++i) {
+        filter.set_gradient(gradients[i].gradient);
+        for (const auto& mode : kModes) {
+          std::vector<cv::Mat> results;
+          std::vector<cv::Mat> references;
+          Render(&filter, mode.mode, gradients[i].gradient, expectations[i],
+                 &results, &references);
+          const Budget& budget =
+              approximates_runs ? kApproximateRunBudget : mode.budget;
+          bool passed = !results.empty();
+          double max = 0.0;
+          double rms = 0.0;
+          for (std::size_t j = 0; j < results.size(); ++j) {
+            const sgss::reference::Difference difference =
+                sgss::reference::Compare(results[j], references[j]);
+            max = std::max(max, difference.max);
+            rms = std::max(rms, difference.rms);
+          }
+          passed = passed && max <= budget.max && rms <= budget.rms;
+          std::printf("%-4s %-9s %-10s %-7s %-16s "
+                      "max %6.3f / %4.2f  rms %6.3f / %4.2f\n",
+                      passed ? "ok" : "FAIL", aperture.name,
+                      sgss::EngineName(engine), gradients[i].name,
+                      mode.name, max, budget.max, rms, budget.rms);
+          if (!passed) {
+            ++failures;
+          }
+        }
+      }
+    }
+  }
+  if (failures) {
+    std::printf("%d failed\n", failures);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
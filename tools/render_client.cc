@@ -0,0 +1,230 @@
+//
+//  tools/render_client.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include <opencv2/opencv.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "sgss/render_protocol.h"
+
+namespace {
+
+namespace render = sgss::render;
+
+const char kUsage[] =
+    "usage: render_client SOCKET --stats\n"
+    "       render_client SOCKET SOURCE DESTINATION "
+    "[GRADIENT [SCALE [FILTER [BRIGHTNESS]]]]\n";
+
+// Frame in anonymous shared memory that can be passed to the daemon
+class SharedFrame {
+ public:
+  // Constructors
+  SharedFrame(const cv::Size& size, int type)
+      : descriptor_(-1), data_(MAP_FAILED), size_() {
+    static int count = 0;
+    const std::string name = "/sgss_render_" + std::to_string(getpid()) +
+                             "_" + std::to_string(count++);
+    descriptor_ = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (descriptor_ < 0) {
+      return;
+    }
+    // The name is no longer needed once opened.
+    shm_unlink(name.c_str());
+    size_ = static_cast<std::size_t>(size.area()) * CV_ELEM_SIZE(type);
+    if (ftruncate(descriptor_, size_)) {
+      return;
+    }
+    data_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                 descriptor_, 0);
+    if (data_ != MAP_FAILED) {
+      mat_ = cv::Mat(size, type, data_);
+    }
+  }
+  SharedFrame(const SharedFrame& other) = delete;
+  ~SharedFrame() {
+    if (data_ != MAP_FAILED) {
+      munmap(data_, size_);
+    }
+    if (descriptor_ >= 0) {
+      close(descriptor_);
+    }
+  }
+
+  // Assignment
+  SharedFrame& operator=(const SharedFrame& other) = delete;
+
+  // Whether the memory is mapped
+  bool valid() const { return data_ != MAP_FAILED; }
+
+  int descriptor() const { return descriptor_; }
+  cv::Mat& mat() { return mat_; }
+
+ private:
+  // Data members
+  int descriptor_;
+  void *data_;
+  std::size_t size_;
+  cv::Mat mat_;
+};
+
+int Connect(const std::string& path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  const int client = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (client < 0) {
+    return -1;
+  }
+  if (connect(client, reinterpret_cast<const sockaddr *>(&address),
+              sizeof(address))) {
+    close(client);
+    return -1;
+  }
+  return client;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::fputs(kUsage, stderr);
+    return EXIT_FAILURE;
+  }
+  const int client = Connect(argv[1]);
+  if (client < 0) {
+    std::fprintf(stderr, "Failed to connect to %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+  render::Request request = render::Request();
+  request.magic = render::kMagic;
+
+  if (std::string(argv[2]) == "--stats") {
+    request.type = static_cast<std::uint32_t>(render::MessageType::kStatistics);
+    render::Statistics statistics;
+    if (!render::Send(client, &request, sizeof(request)) ||
+        !render::Receive(client, &statistics, sizeof(statistics))) {
+      std::fputs("Failed to communicate with the daemon\n", stderr);
+      return EXIT_FAILURE;
+    }
+    std::printf("workers      %u\n", statistics.workers);
+    std::printf("queue depth  %u\n", statistics.queue_depth);
+    std::printf("completed    %llu\n",
+                static_cast<unsigned long long>(statistics.completed));
+    std::printf("failed       %llu\n",
+                static_cast<unsigned long long>(statistics.failed));
+    std::printf("latency p50  %.3f ms\n", statistics.latency_p50 * 1000.0);
+    std::printf("latency p90  %.3f ms\n", statistics.latency_p90 * 1000.0);
+    std::printf("latency p99  %.3f ms\n", statistics.latency_p99 * 1000.0);
+    std::printf("latency max  %.3f ms\n", statistics.latency_max * 1000.0);
+    return EXIT_SUCCESS;
+  }
+  if (argc < 4) {
+    std::fputs(kUsage, stderr);
+    return EXIT_FAILURE;
+  }
+
+  // Copy the images into shared memory once. Clients producing frames in
+  // shared memory in the first place pass them without any copy.
+  const cv::Mat image(cv::imread(argv[2]));
+  if (image.empty()) {
+    std::fprintf(stderr, "Failed to read %s\n", argv[2]);
+    return EXIT_FAILURE;
+  }
+  SharedFrame source(image.size(), image.type());
+  SharedFrame destination(image.size(), image.type());
+  if (!source.valid() || !destination.valid()) {
+    std::fputs("Failed to allocate shared memory\n", stderr);
+    return EXIT_FAILURE;
+  }
+  image.copyTo(source.mat());
+  request.type = static_cast<std::uint32_t>(render::MessageType::kRender);
+  request.id = 1;
+  request.filter = argc > 6 ? std::atoi(argv[6]) : 0;
+  request.width = image.cols;
+  request.height = image.rows;
+  request.frame_type = image.type();
+  request.brightness = argc > 7 ? std::atof(argv[7]) : 1.0;
+  int descriptors[render::kMaxDescriptors] = {
+    source.descriptor(),
+    destination.descriptor(),
+  };
+  std::size_t descriptor_count = 2;
+  cv::Mat gradient_image;
+  std::unique_ptr<SharedFrame> gradient;
+  if (argc > 4) {
+    gradient_image = cv::imread(argv[4], cv::IMREAD_GRAYSCALE);
+    if (gradient_image.empty()) {
+      std::fprintf(stderr, "Failed to read %s\n", argv[4]);
+      return EXIT_FAILURE;
+    }
+    gradient.reset(new SharedFrame(gradient_image.size(),
+                                   gradient_image.type()));
+    if (!gradient->valid()) {
+      std::fputs("Failed to allocate shared memory\n", stderr);
+      return EXIT_FAILURE;
+    }
+    gradient_image.copyTo(gradient->mat());
+    request.gradient_width = gradient_image.cols;
+    request.gradient_height = gradient_image.rows;
+    request.gradient_type = gradient_image.type();
+    request.gradient_scale = argc > 5 ? std::atoi(argv[5]) : 1;
+    descriptors[descriptor_count++] = gradient->descriptor();
+  }
+
+  render::Response response;
+  if (!render::Send(client, &request, sizeof(request),
+            descriptors, descriptor_count) ||
+      !render::Receive(client, &response, sizeof(response))) {
+    std::fputs("Failed to communicate with the daemon\n", stderr);
+    return EXIT_FAILURE;
+  }
+  if (response.status != static_cast<std::uint32_t>(render::Status::kOK)) {
+    std::fprintf(stderr, "Request failed with status %u\n", response.status);
+    return EXIT_FAILURE;
+  }
+  std::printf("queued %.3f ms, rendered %.3f ms\n",
+              response.queue_seconds * 1000.0,
+              response.render_seconds * 1000.0);
+  if (!cv::imwrite(argv[3], destination.mat())) {
+    std::fprintf(stderr, "Failed to write %s\n", argv[3]);
+    return EXIT_FAILURE;
+  }
+  close(client);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+//
+//  tools/render_daemon.cc
+//
+//  MIT License
+//
+//  Copyright (C) 2013-2014 Shota Matsuda
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a
+//  copy of this software and associated documentation files (the "Software"),
+//  to deal in the Software without restriction, including without limitation
+//  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+//  and/or sell copies of the Software, and to permit persons to whom the
+//  Software is furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in
+//  all copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+//  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+//  DEALINGS IN THE SOFTWARE.
+//
+
+#include <opencv2/opencv.hpp>
+
+#include <signal.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "sgss/aperture.h"
+#include "sgss/engine.h"
+#include "sgss/lens_blur_filter.h"
+#include "sgss/render_server.h"
+
+namespace {
+
+const char kUsage[] =
+    "usage: render_daemon [options]\n"
+    "  --socket PATH     Unix domain socket to listen on\n"
+    "  --workers COUNT   Number of worker threads\n"
+    "  --queue COUNT     Number of requests to queue at most\n"
+    "  --filter SIZE[:BLADES]\n"
+    "                    Prepares a filter of the kernel size and the number\n"
+    "                    of diaphragm blades, or a disc without blades.\n"
+    "                    Filters are numbered in order from zero.\n"
+    "  --profile PATH    Engine profile of this host, extended if missing\n"
+    "  --tile SIZE       Filters frames in tiles of the size\n";
+
+// Prepared filter
+struct FilterSpec {
+  int size;
+  int blades;
+};
+
+sgss::render::Server *server_instance = nullptr;
+
+void HandleSignal(int) {
+  if (server_instance) {
+    server_instance->Stop();
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string path = "/tmp/sgss_render.sock";
+  std::size_t worker_count = cv::getNumberOfCPUs();
+  std::size_t queue_limit = 256;
+  std::vector<FilterSpec> specs;
+  std::string profile_path;
+  int tile_size = 0;
+  for (int i = 1; i < argc; ++i) {
+    const std::string option(argv[i]);
+    if (i + 1 >= argc) {
+      std::fputs(kUsage, stderr);
+      return EXIT_FAILURE;
+    }
+    const char *value = argv[++i];
+    if (option == "--socket") {
+      path = value;
+    } else if (option == "--workers") {
+      worker_count = std::max(std::atoi(value), 1);
+    } else if (option == "--queue") {
+      queue_limit = std::max(std::atoi(value), 1);
+    } else if (option == "--filter") {
+      FilterSpec spec = FilterSpec();
+      if (std::sscanf(value, "%d:%d", &spec.size, &spec.blades) < 1 ||
+          spec.size <= 0 || spec.size % 2 != 1) {
+        std::fprintf(stderr, "Invalid filter: %s\n", value);
+        return EXIT_FAILURE;
+      }
+      specs.push_back(spec);
+    } else if (option == "--profile") {
+      profile_path = value;
+    } else if (option == "--tile") {
+      tile_size = std::atoi(value);
+    } else {
+      std::fputs(kUsage, stderr);
+      return EXIT_FAILURE;
+    }
+  }
+  if (specs.empty()) {
+    specs.push_back(FilterSpec{27, 0});
+  }
+  const auto make_filter = [](const FilterSpec& spec) {
+    const sgss::Aperture aperture(spec.blades > 2 ?
+        sgss::Aperture::Polygon(spec.blades) :
+        sgss::Aperture::Disc());
+    return sgss::LensBlurFilter(aperture, cv::Size(spec.size, spec.size));
+  };
+
+  // Measure engines of the kernels that this host hasn't measured before.
+  // Entries are kept for every kernel, so that filters of the same size
+  // but other apertures measure their own.
+  sgss::EngineProfile profile;
+  if (!profile_path.empty()) {
+    profile.Load(profile_path);
+    bool measured = false;
+    for (const auto& spec : specs) {
+      sgss::LensBlurFilter filter(make_filter(spec));
+      filter.set_engine_profile(profile);
+      if (!filter.calibrated()) {
+        filter.Calibrate();
+        profile = filter.engine_profile();
+        measured = true;
+      }
+    }
+    if (measured && !profile.Save(profile_path)) {
+      std::fprintf(stderr, "Failed to save %s\n", profile_path.c_str());
+    }
+  }
+
+  // Every worker makes its own filters from the specs, so that none of them
+  // share filter engines.
+  std::vector<sgss::render::Server::FilterFactory> factories;
+  for (const auto& spec : specs) {
+    factories.push_back([=]() {
+      sgss::LensBlurFilter filter(make_filter(spec));
+      if (!profile.empty()) {
+        filter.set_engine_profile(profile);
+      }
+      if (tile_size > 0) {
+        filter.set_tile_size(cv::Size(tile_size, tile_size));
+      }
+      return filter;
+    });
+  }
+  sgss::render::Server server(path, factories, worker_count, queue_limit);
+  if (!server.Start()) {
+    std::fprintf(stderr, "Failed to listen on %s: %s\n",
+                 path.c_str(), std::strerror(errno));
+    return EXIT_FAILURE;
+  }
+  server_instance = &server;
+  struct sigaction action = {};
+  action.sa_handler = HandleSignal;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+  signal(SIGPIPE, SIG_IGN);
+  std::fprintf(stderr, "Listening on %s with %zu workers\n",
+               path.c_str(), worker_count);
+  server.Run();
+  server_instance = nullptr;
+  return EXIT_SUCCESS;
+}